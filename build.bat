@@ -1,11 +1,12 @@
 @echo off
 :: build.bat
-::./build.bat source [--mt] [--bmp] -> to generate the obj files in bin_int and exe file in bin
+::./build.bat source [--mt] [--bmp] [--pfm] -> to generate the obj files in bin_int and exe file in bin
 ::./build.bat clear -> to delete bin_int and bin
 ::./build.bat clear_bin -> to delete bin
 ::./build.bat clear_bin_int -> to delete bin_int
 ::./build.bat info -> debugging information
-::./build.bat render -> to render the bin/EXE
+::./build.bat render [file_name] [--seed <n>] [--passes <n>] [--checkpoint <seconds>] [--resume] [--time <seconds>] [--shard <i>/<n>] -> to render the bin/EXE
+::./build.bat render merge <file_name> <n> -> to merge the shards of a sharded render
 
 :: Checking dependencies
 where clang 2>NUL 1>&2
@@ -29,8 +30,13 @@ if "%1"=="source" (
     set "DEFINES="
     if "%2"=="--mt" set "DEFINES=-DMULTITHREADING"
     if "%2"=="--bmp" set "DEFINES=-DBMP"
+    if "%2"=="--pfm" set "DEFINES=-DPFM"
     if "%3"=="--mt" set "DEFINES=!DEFINES! -DMULTITHREADING"
     if "%3"=="--bmp" set "DEFINES=!DEFINES! -DBMP"
+    if "%3"=="--pfm" set "DEFINES=!DEFINES! -DPFM"
+    if "%4"=="--mt" set "DEFINES=!DEFINES! -DMULTITHREADING"
+    if "%4"=="--bmp" set "DEFINES=!DEFINES! -DBMP"
+    if "%4"=="--pfm" set "DEFINES=!DEFINES! -DPFM"
     
     make -f build.mak all CODE_DIRS="source" BIN_INT_DIR="win32" ARCH="%PROCESSOR_ARCHITECTURE%" MACROS="!DEFINES!"
     exit /b %errorlevel%
@@ -60,7 +66,7 @@ if "%1"=="clear_bin_int" (
 :: Running the executable if requested
 if "%1"=="render" (
     if exist .\bin\EXE.exe (
-        .\bin\EXE.exe %2
+        .\bin\EXE.exe %2 %3 %4 %5 %6 %7 %8 %9
         exit /b 0
     ) else (
         echo EXE.exe not found in bin directory
@@ -70,10 +76,11 @@ if "%1"=="render" (
 
 :: If no valid command was provided
 echo Invalid command. Available commands:
-echo   source [--mt] [--bmp]
+echo   source [--mt] [--bmp] [--pfm]
 echo   clear
 echo   clear_bin
 echo   clear_bin_int
 echo   info
-echo   render
+echo   render [file_name] [--seed ^<n^>] [--passes ^<n^>] [--checkpoint ^<seconds^>] [--resume] [--time ^<seconds^>] [--shard ^<i^>/^<n^>]
+echo   render merge ^<file_name^> ^<n^>
 exit /b 1
\ No newline at end of file
@@ -1,12 +1,13 @@
 #!/bin/bash
 
 # commands:
-# ./build.sh source [--mt] [--bmp] -> to generate the obj files in bin_int and exe file in bin
+# ./build.sh source [--mt] [--bmp] [--pfm] -> to generate the obj files in bin_int and exe file in bin
 # ./build.sh clear -> to delete bin_int and bin
 # ./build.sh clear_bin -> to delete bin
 # ./build.sh clear_bin_int -> to delete bin_int
 # ./build.sh info -> debugging information
-# ./build.sh render -> to render the bin/EXE
+# ./build.sh render [file_name] [--seed <n>] [--passes <n>] [--checkpoint <seconds>] [--resume] [--time <seconds>] [--shard <i>/<n>] -> to render the bin/EXE
+# ./build.sh render merge <file_name> <n> -> to merge the shards of a sharded render
 
 # Checking dependencies
 if ! command -v clang &> /dev/null; then
@@ -34,6 +35,9 @@ case "$1" in
                 "--bmp")
                     DEFINE_FLAGS="$DEFINE_FLAGS -DBMP"
                     ;;
+                "--pfm")
+                    DEFINE_FLAGS="$DEFINE_FLAGS -DPFM"
+                    ;;
             esac
         done
         
@@ -58,7 +62,7 @@ case "$1" in
         
     "render")
         if [ -f "./bin/EXE" ]; then
-            ./bin/EXE "$2"
+            ./bin/EXE "${@:2}"
         else
             echo "EXE not found in bin directory"
             exit 1
@@ -67,12 +71,13 @@ case "$1" in
         
     *)
         echo "Invalid command. Available commands:"
-        echo "  source [--mt] [--bmp]"
+        echo "  source [--mt] [--bmp] [--pfm]"
         echo "  clear"
         echo "  clear_bin"
         echo "  clear_bin_int"
         echo "  info"
-        echo "  render"
+        echo "  render [file_name] [--seed <n>] [--passes <n>] [--checkpoint <seconds>] [--resume] [--time <seconds>] [--shard <i>/<n>]"
+        echo "  render merge <file_name> <n>"
         exit 1
         ;;
 esac
@@ -63,7 +63,7 @@ void* _darray_resize(void* array) {
     u64 current_data_size = block[DARRAY_FIELD_STRIDE] * block[DARRAY_FIELD_CAPACITY];
     u64 new_data_size = current_data_size * DARRAY_RESIZE_FACTOR;
     // Realloc with both header and new data size
-    block = zmemory_reallocate(block, new_data_size, current_data_size);
+    block = zmemory_reallocate(block, DARRAY_HEADER_SIZE + new_data_size, DARRAY_HEADER_SIZE + current_data_size);
     block[DARRAY_FIELD_CAPACITY] *= DARRAY_RESIZE_FACTOR;
 
     return block ? (block + DARRAY_FIELD_MAX) : 0;
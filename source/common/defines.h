@@ -40,6 +40,8 @@ typedef _Bool bool;
 #define DBL_EPSILON 2.2204460492503131e-16
 #define FLT_EPSILON 1.19209290e-7F
 
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define CLAMP(min, max, val) ((val) < (min) ? (min) : ((val) > (max) ? (max) : (val)))
 #define DEG_TO_RAD(val) ((val) * PI / 180)
 #define IS_POWER_OF_2(val) ((bool)(((val) != 0) && ((val) & ((val) - 1)) == 0))
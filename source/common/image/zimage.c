@@ -0,0 +1,165 @@
+#include "zimage.h"
+#include "logger.h"
+#include "zmemory.h"
+#include "zmath.h"
+
+#define GAMMA 0.5
+
+typedef struct {
+    u16 bfType;
+    u32 bfSize;
+    u16 bfReserved1;
+    u16 bfReserved2;
+    u32 bfOffBits;
+} __attribute__((packed)) BMPFileHeader;
+
+typedef struct {
+    u32 biSize;
+    i32 biWidth;
+    i32 biHeight;
+    u16 biPlanes;
+    u16 biBitCount;
+    u32 biCompression;
+    u32 biSizeImage;
+    i32 biXPelsPerMeter;
+    i32 biYPelsPerMeter;
+    u32 biClrUsed;
+    u32 biClrImportant;
+} __attribute__((packed)) BMPDIBHeader;
+
+INLINE u8 zimage_encode(f32 val) {
+    // gamma correction
+    f64 encoded = val > 0.0f ? zpow(val, GAMMA) : 0.0;
+    return (u8)CLAMP(0, 255, (i32)(255.9999 * encoded));
+}
+
+bool zimage_create(i32 width, i32 height, zimage* out_image) {
+    if (width <= 0 || height <= 0 || out_image == 0) {
+        LOGE("zimage_create: invalid params");
+        return false;
+    }
+    out_image->width = width;
+    out_image->height = height;
+    out_image->pixels = zmemory_allocate((u64)width * height * 3 * sizeof(f32));
+    if (out_image->pixels == 0) {
+        LOGE("zimage_create: failed to allocate memory");
+        return false;
+    }
+    return true;
+}
+
+void zimage_destroy(zimage* image) {
+    if (image == 0 || image->pixels == 0) {
+        LOGE("zimage_destroy: invalid params");
+        return;
+    }
+    zmemory_free(image->pixels, (u64)image->width * image->height * 3 * sizeof(f32));
+    image->pixels = 0;
+}
+
+bool zimage_write_ppm(const zimage* image, const char* file_path) {
+    if (image == 0 || image->pixels == 0 || file_path == 0) {
+        LOGE("zimage_write_ppm: invalid params");
+        return false;
+    }
+    FILE* file = file_open(file_path, true, FILE_MODE_WRITE);
+    if (file == 0) {
+        LOGE("zimage_write_ppm: failed to open %s", file_path);
+        return false;
+    }
+    LOG_FILE(file, "P6\n%d %d\n255\n", image->width, image->height);
+
+    u64 row_size = (u64)image->width * 3;
+    u8* row = zmemory_allocate(row_size);
+    bool result = true;
+    for (i32 y = 0; y < image->height && result; ++y) {
+        const f32* src = image->pixels + y * row_size;
+        for (u64 i = 0; i < row_size; ++i) {
+            row[i] = zimage_encode(src[i]);
+        }
+        result = file_write(row, 1, row_size, file) == row_size;
+    }
+    zmemory_free(row, row_size);
+    file_close(file);
+    if (!result) {
+        LOGE("zimage_write_ppm: failed to write %s", file_path);
+    }
+    return result;
+}
+
+bool zimage_write_bmp(const zimage* image, const char* file_path) {
+    if (image == 0 || image->pixels == 0 || file_path == 0) {
+        LOGE("zimage_write_bmp: invalid params");
+        return false;
+    }
+    FILE* file = file_open(file_path, true, FILE_MODE_WRITE);
+    if (file == 0) {
+        LOGE("zimage_write_bmp: failed to open %s", file_path);
+        return false;
+    }
+
+    // every row is padded to 4 bytes
+    u32 padding = (4 - (image->width * 3) % 4) % 4;
+    u32 row_size = image->width * 3 + padding;
+
+    BMPFileHeader file_header = {
+        .bfType = 0x4D42, // "BM"
+        .bfSize = sizeof(BMPFileHeader) + sizeof(BMPDIBHeader) + image->height * row_size,
+        .bfOffBits = sizeof(BMPFileHeader) + sizeof(BMPDIBHeader),
+    };
+    BMPDIBHeader dib_header = {
+        .biSize = sizeof(BMPDIBHeader),
+        .biWidth = image->width,
+        .biHeight = -image->height, // negative for top-down rows
+        .biPlanes = 1,
+        .biBitCount = 24,
+        .biSizeImage = image->height * row_size,
+    };
+    file_write(&file_header, sizeof(BMPFileHeader), 1, file);
+    file_write(&dib_header, sizeof(BMPDIBHeader), 1, file);
+
+    u8* row = zmemory_allocate(row_size); // zeroed, so the padding stays 0
+    bool result = true;
+    for (i32 y = 0; y < image->height && result; ++y) {
+        const f32* src = image->pixels + (u64)y * image->width * 3;
+        for (i32 x = 0; x < image->width; ++x) {
+            // bgr order
+            row[x * 3 + 0] = zimage_encode(src[x * 3 + 2]);
+            row[x * 3 + 1] = zimage_encode(src[x * 3 + 1]);
+            row[x * 3 + 2] = zimage_encode(src[x * 3 + 0]);
+        }
+        result = file_write(row, 1, row_size, file) == row_size;
+    }
+    zmemory_free(row, row_size);
+    file_close(file);
+    if (!result) {
+        LOGE("zimage_write_bmp: failed to write %s", file_path);
+    }
+    return result;
+}
+
+bool zimage_write_pfm(const zimage* image, const char* file_path) {
+    if (image == 0 || image->pixels == 0 || file_path == 0) {
+        LOGE("zimage_write_pfm: invalid params");
+        return false;
+    }
+    FILE* file = file_open(file_path, true, FILE_MODE_WRITE);
+    if (file == 0) {
+        LOGE("zimage_write_pfm: failed to open %s", file_path);
+        return false;
+    }
+    // negative scale means little endian
+    LOG_FILE(file, "PF\n%d %d\n-1.0\n", image->width, image->height);
+
+    // pfm rows go bottom to top
+    u64 row_count = (u64)image->width * 3;
+    bool result = true;
+    for (i32 y = image->height - 1; y >= 0 && result; --y) {
+        result = file_write(image->pixels + y * row_count, sizeof(f32), row_count, file) == row_count;
+    }
+    file_close(file);
+    if (!result) {
+        LOGE("zimage_write_pfm: failed to write %s", file_path);
+    }
+    return result;
+}
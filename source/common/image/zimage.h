@@ -0,0 +1,33 @@
+#ifndef ZIMAGE__H
+#define ZIMAGE__H
+
+#include "defines.h"
+
+/**
+ * @brief rgb float image in linear color, rows are stored top to bottom
+ * the 8 bit writers (ppm, bmp) apply gamma correction and clamp, pfm keeps the raw linear values
+ */
+typedef struct zimage {
+    i32 width;
+    i32 height;
+    f32* pixels; // width * height * 3 floats
+} zimage;
+
+bool zimage_create(i32 width, i32 height, zimage* out_image);
+
+void zimage_destroy(zimage* image);
+
+INLINE f32* zimage_pixel(zimage* image, i32 x, i32 y) {
+    return image->pixels + ((u64)y * image->width + x) * 3;
+}
+
+/// binary P6 ppm
+bool zimage_write_ppm(const zimage* image, const char* file_path);
+
+/// 24 bit uncompressed bmp
+bool zimage_write_bmp(const zimage* image, const char* file_path);
+
+/// little endian float pfm (linear, no gamma)
+bool zimage_write_pfm(const zimage* image, const char* file_path);
+
+#endif
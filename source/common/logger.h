@@ -42,6 +42,4 @@ u32 file_position(FILE* file);
 
 i32 file_seek_end(FILE* file);
 
-void convert_ppm_to_bmp(const char* ppm_file, const char* bmp_file);
-
 #endif
\ No newline at end of file
@@ -71,20 +71,26 @@ f64 zround(f64 val) {
     return round(val);
 }
 
+_Thread_local u64 random_state = 0;
+
+static u64 global_seed = 0;
+
 void random_seed() {
-    srand(platform_time());
+    random_seed_set((u64)(platform_time() * 1000000.0));
 }
 
-f64 random_unit() {
-    return rand() / ((f64)RAND_MAX + 1.0); // [0,1)
+void random_seed_set(u64 seed) {
+    global_seed = seed;
+    random_state = random_mix(seed);
 }
 
-f64 random_double(f64 min, f64 max) {
-    return min + random_unit() * (max - min); //[min,max)
+u64 random_seed_get() {
+    return global_seed;
 }
 
-i32 random_int(i32 min, i32 max) {
-    return min + (int)(random_unit() * (max - min)); //[min,max)
+void random_seed_sample(u64 stream, u64 index) {
+    // hashing the index too keeps neighbouring samples from getting shifted copies of the same sequence
+    random_state = random_mix(random_mix(global_seed ^ random_mix(stream)) + index);
 }
 
 void quick_sort(void* base, u64 count, u64 stride, int (*cmp)(const void* a, const void* b)) {
@@ -94,3 +100,13 @@ void quick_sort(void* base, u64 count, u64 stride, int (*cmp)(const void* a, con
 f64 zlog(f64 val) {
     return log(val);
 }
+
+f32 zfloat_round_down(f64 val) {
+    f32 result = (f32)val;
+    return (result > val) ? nextafterf(result, -INFINITY) : result;
+}
+
+f32 zfloat_round_up(f64 val) {
+    f32 result = (f32)val;
+    return (result < val) ? nextafterf(result, INFINITY) : result;
+}
@@ -39,13 +39,52 @@ f64 zround(f64 val);
 
 f64 zlog(f64 val);
 
+/// nearest float <= val, for conservative float bounds
+f32 zfloat_round_down(f64 val);
+
+/// nearest float >= val, for conservative float bounds
+f32 zfloat_round_up(f64 val);
+
+/**
+ * @brief every thread owns its own random stream (splitmix64, counter based)
+ * the camera reseeds the stream per (pixel, sample) with random_seed_sample so images don't depend
+ * on the thread count or the order the work was scheduled in
+ */
+extern _Thread_local u64 random_state;
+
+/// seeds from the current time
 void random_seed();
 
-f64 random_unit();
+/// fixed seed, same seed gives the same image
+void random_seed_set(u64 seed);
+
+u64 random_seed_get();
+
+/// restarts the calling thread's stream at a position derived from the global seed, stream and index
+void random_seed_sample(u64 stream, u64 index);
 
-f64 random_double(f64 min, f64 max);
+INLINE u64 random_mix(u64 val) {
+    val = (val ^ (val >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    val = (val ^ (val >> 27)) * 0x94d049bb133111ebULL;
+    return val ^ (val >> 31);
+}
 
-i32 random_int(i32 min, i32 max);
+INLINE u64 random_u64() {
+    random_state += 0x9e3779b97f4a7c15ULL;
+    return random_mix(random_state);
+}
+
+INLINE f64 random_unit() {
+    return (random_u64() >> 11) * (1.0 / 9007199254740992.0); // [0,1) using the top 53 bits
+}
+
+INLINE f64 random_double(f64 min, f64 max) {
+    return min + random_unit() * (max - min); //[min,max)
+}
+
+INLINE i32 random_int(i32 min, i32 max) {
+    return min + (i32)(random_unit() * (max - min)); //[min,max)
+}
 
 typedef int (*qsort_cmp)(const void* a, const void* b);
 void quick_sort(void* base, u64 count, u64 stride, int (*cmp)(const void* a, const void* b));
@@ -60,6 +99,11 @@ typedef struct mat3 {
     f32 data[9];
 } mat3;
 
+/// affine transform, 3 rows of (linear part | translation), applied as m * (x, y, z, 1)
+typedef struct mat3x4 {
+    f64 m[3][4];
+} mat3x4;
+
 typedef vec3 point3;
 typedef vec3 color;
 
@@ -317,4 +361,88 @@ INLINE vec3 mat3_mul_vec3(mat3 mtx, vec3 vec) {
     };
 }
 
+INLINE mat3x4 mat3x4_identity() {
+    return (mat3x4){{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+}
+
+INLINE mat3x4 mat3x4_translation(vec3 offset) {
+    return (mat3x4){{{1, 0, 0, offset.x}, {0, 1, 0, offset.y}, {0, 0, 1, offset.z}}};
+}
+
+INLINE mat3x4 mat3x4_scale(vec3 scale) {
+    return (mat3x4){{{scale.x, 0, 0, 0}, {0, scale.y, 0, 0}, {0, 0, scale.z, 0}}};
+}
+
+/// same rotation as mat3_rotation but in double precision
+INLINE mat3x4 mat3x4_rotation(f64 rad, vec3 axis) {
+    vec3 a = vec3_unit(axis);
+    f64 COS = zcos(rad);
+    f64 SIN = zsin(rad);
+    f64 one_minus_C = 1.0 - COS;
+    f64 xy = a.x * a.y * one_minus_C;
+    f64 xz = a.x * a.z * one_minus_C;
+    f64 yz = a.y * a.z * one_minus_C;
+    return (mat3x4){{
+        {a.x * a.x * one_minus_C + COS, xy - a.z * SIN, xz + a.y * SIN, 0},
+        {xy + a.z * SIN, a.y * a.y * one_minus_C + COS, yz - a.x * SIN, 0},
+        {xz - a.y * SIN, yz + a.x * SIN, a.z * a.z * one_minus_C + COS, 0},
+    }};
+}
+
+/// a * b, b is applied first
+INLINE mat3x4 mat3x4_mul(mat3x4 a, mat3x4 b) {
+    mat3x4 result;
+    for (i32 row = 0; row < 3; ++row) {
+        for (i32 col = 0; col < 4; ++col) {
+            result.m[row][col] = a.m[row][0] * b.m[0][col] + a.m[row][1] * b.m[1][col] + a.m[row][2] * b.m[2][col];
+        }
+        result.m[row][3] += a.m[row][3];
+    }
+    return result;
+}
+
+/// inverse of the linear part (adjugate / determinant) and the translation moved back through it
+INLINE mat3x4 mat3x4_inverse(mat3x4 mtx) {
+    f64(*m)[4] = mtx.m;
+    f64 c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    f64 c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    f64 c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    f64 inv_det = 1.0 / (m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02);
+    mat3x4 result = {{
+        {c00 * inv_det, (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det, (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det, 0},
+        {c01 * inv_det, (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det, (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det, 0},
+        {c02 * inv_det, (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det, (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det, 0},
+    }};
+    for (i32 row = 0; row < 3; ++row) {
+        result.m[row][3] = -(result.m[row][0] * m[0][3] + result.m[row][1] * m[1][3] + result.m[row][2] * m[2][3]);
+    }
+    return result;
+}
+
+INLINE point3 mat3x4_mul_point(const mat3x4* mtx, point3 p) {
+    return (point3){
+        mtx->m[0][0] * p.x + mtx->m[0][1] * p.y + mtx->m[0][2] * p.z + mtx->m[0][3],
+        mtx->m[1][0] * p.x + mtx->m[1][1] * p.y + mtx->m[1][2] * p.z + mtx->m[1][3],
+        mtx->m[2][0] * p.x + mtx->m[2][1] * p.y + mtx->m[2][2] * p.z + mtx->m[2][3],
+    };
+}
+
+/// directions ignore the translation
+INLINE vec3 mat3x4_mul_vec3(const mat3x4* mtx, vec3 v) {
+    return (vec3){
+        mtx->m[0][0] * v.x + mtx->m[0][1] * v.y + mtx->m[0][2] * v.z,
+        mtx->m[1][0] * v.x + mtx->m[1][1] * v.y + mtx->m[1][2] * v.z,
+        mtx->m[2][0] * v.x + mtx->m[2][1] * v.y + mtx->m[2][2] * v.z,
+    };
+}
+
+/// transpose of the linear part times v, with the inverse transform this moves normals to the other space
+INLINE vec3 mat3x4_transpose_mul_vec3(const mat3x4* mtx, vec3 v) {
+    return (vec3){
+        mtx->m[0][0] * v.x + mtx->m[1][0] * v.y + mtx->m[2][0] * v.z,
+        mtx->m[0][1] * v.x + mtx->m[1][1] * v.y + mtx->m[2][1] * v.z,
+        mtx->m[0][2] * v.x + mtx->m[1][2] * v.y + mtx->m[2][2] * v.z,
+    };
+}
+
 #endif
\ No newline at end of file
@@ -42,16 +42,16 @@ void* zmemory_allocate(u64 size) {
         return 0;
     }
 
-    zmutex_lock(&state_ptr->mutex);
     void* block = malloc(size);
-    memset(block, 0, size);
-    state_ptr->allocated_memory += size;
-    zmutex_unlock(&state_ptr->mutex);
-
     if (!block) {
         LOGE("zmemory_allocate : malloc failed");
         return 0;
     }
+    memset(block, 0, size);
+
+    zmutex_lock(&state_ptr->mutex);
+    state_ptr->allocated_memory += size;
+    zmutex_unlock(&state_ptr->mutex);
     return block;
 }
 
@@ -9,4 +9,23 @@ f64 platform_time();
 
 u32 platform_get_processor_count();
 
+/// true if the cpu can run AVX2 and FMA instructions
+bool platform_cpu_supports_avx2();
+
+typedef struct platform_file_mapping {
+    const u8* data;
+    u64 size;
+    void* internal_data;
+} platform_file_mapping;
+
+/// maps the whole file read only, the os pages it in as it is touched and no copy is made
+bool platform_file_map(const char* file_path, platform_file_mapping* out_mapping);
+
+void platform_file_unmap(platform_file_mapping* mapping);
+
+/// moves from_path over to_path in one step, a reader of to_path sees the old or the new file but never a partial one
+bool platform_file_replace(const char* from_path, const char* to_path);
+
+bool platform_file_remove(const char* file_path);
+
 #endif
\ No newline at end of file
@@ -7,11 +7,17 @@
 #    include <stdlib.h>
 #    include <time.h>
 #    include <sys/sysinfo.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <fcntl.h>
+#    include <stdio.h>
 #    include <semaphore.h>
 #    include "zmemory.h"
 #    include "logger.h"
 #    include "zthread.h"
 #    include "zmutex.h"
+#    include "zthread_pool.h"
+#    include "zatomic.h"
 // use - lrt(real time library) while linking
 
 void platform_sleep(u64 ms) {
@@ -32,6 +38,76 @@ u32 platform_get_processor_count(void) {
     return processors_available;
 }
 
+bool platform_cpu_supports_avx2() {
+#    if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#    else
+    return false;
+#    endif
+}
+
+bool platform_file_map(const char* file_path, platform_file_mapping* out_mapping) {
+    if (0 == file_path || 0 == out_mapping) {
+        LOGE("platform_file_map: invalid params");
+        return false;
+    }
+    i32 fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        LOGE("platform_file_map: failed to open %s", file_path);
+        return false;
+    }
+    struct stat info;
+    if (0 != fstat(fd, &info) || info.st_size == 0) {
+        LOGE("platform_file_map: %s is empty or unreadable", file_path);
+        close(fd);
+        return false;
+    }
+    void* data = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (MAP_FAILED == data) {
+        LOGE("platform_file_map: failed to map %s", file_path);
+        return false;
+    }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+    out_mapping->data = data;
+    out_mapping->size = info.st_size;
+    out_mapping->internal_data = 0;
+    return true;
+}
+
+void platform_file_unmap(platform_file_mapping* mapping) {
+    if (0 == mapping || 0 == mapping->data) {
+        LOGE("platform_file_unmap: invalid params");
+        return;
+    }
+    munmap((void*)mapping->data, mapping->size);
+    mapping->data = 0;
+    mapping->size = 0;
+}
+
+bool platform_file_replace(const char* from_path, const char* to_path) {
+    if (0 == from_path || 0 == to_path) {
+        LOGE("platform_file_replace: invalid params");
+        return false;
+    }
+    // rename is atomic within a file system
+    if (0 != rename(from_path, to_path)) {
+        LOGE("platform_file_replace: failed to move %s to %s", from_path, to_path);
+        return false;
+    }
+    return true;
+}
+
+bool platform_file_remove(const char* file_path) {
+    if (0 == file_path) {
+        LOGE("platform_file_remove: invalid params");
+        return false;
+    }
+    return 0 == unlink(file_path);
+}
+
 bool zthread_create(PFN_zthread_start_func func, void* params, zthread* out_thread) {
     if (0 == func || 0 == params || 0 == out_thread) {
         LOGE("zthread_create: invalid params");
@@ -138,4 +214,355 @@ bool zmutex_unlock(zmutex* mutex) {
     return true;
 }
 
+#    define ZTHREAD_JOB_QUEUE_DEFAULT_CAPACITY 64
+#    define ZTHREAD_POOL_WAIT_TIMEOUT_NS 1000000 // 1ms
+
+typedef struct zthread_job {
+    PFN_zthread_job func;
+    void* params;
+    zthread_wait_group* group;
+} zthread_job;
+
+// ring buffer, the owner pushes and pops at the back and thieves take from the front
+typedef struct zthread_job_queue {
+    pthread_mutex_t mutex;
+    zthread_job* jobs;
+    u32 capacity;
+    u32 front;
+    u32 count;
+} zthread_job_queue;
+
+typedef struct zthread_pool_state {
+    pthread_t* threads;
+    zthread_job_queue* queues;
+    u32 thread_count;
+    volatile i32 pending_jobs; // jobs queued but not yet taken by any thread
+    volatile i32 next_queue;   // round robin for submissions from outside the pool
+    volatile i32 running;
+    pthread_mutex_t sleep_mutex;
+    pthread_cond_t sleep_cond;
+} zthread_pool_state;
+
+typedef struct zthread_worker_params {
+    zthread_pool_state* state;
+    u32 index;
+} zthread_worker_params;
+
+typedef struct zthread_wait_group_state {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    i32 count;
+} zthread_wait_group_state;
+
+// identifies the worker (and its queue) running on the current thread
+static _Thread_local zthread_pool_state* current_pool = 0;
+static _Thread_local u32 current_worker = 0;
+
+bool zthread_job_queue_push(zthread_job_queue* queue, zthread_job job) {
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count == queue->capacity) {
+        u32 new_capacity = queue->capacity * 2;
+        zthread_job* jobs = zmemory_allocate(sizeof(zthread_job) * new_capacity);
+        if (!jobs) {
+            pthread_mutex_unlock(&queue->mutex);
+            return false;
+        }
+        for (u32 i = 0; i < queue->count; ++i) {
+            jobs[i] = queue->jobs[(queue->front + i) % queue->capacity];
+        }
+        zmemory_free(queue->jobs, sizeof(zthread_job) * queue->capacity);
+        queue->jobs = jobs;
+        queue->capacity = new_capacity;
+        queue->front = 0;
+    }
+    queue->jobs[(queue->front + queue->count) % queue->capacity] = job;
+    queue->count++;
+    pthread_mutex_unlock(&queue->mutex);
+    return true;
+}
+
+bool zthread_job_queue_pop_back(zthread_job_queue* queue, zthread_job* out_job) {
+    bool found = false;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count) {
+        queue->count--;
+        *out_job = queue->jobs[(queue->front + queue->count) % queue->capacity];
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+bool zthread_job_queue_steal_front(zthread_job_queue* queue, zthread_job* out_job) {
+    bool found = false;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count) {
+        *out_job = queue->jobs[queue->front];
+        queue->front = (queue->front + 1) % queue->capacity;
+        queue->count--;
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+// own queue first (newest job, still warm in cache) then steal the oldest job of the others
+bool zthread_pool_take_job(zthread_pool_state* state, zthread_job* out_job) {
+    if (zatomic_load_i32(&state->pending_jobs) <= 0) {
+        return false;
+    }
+    u32 start = 0;
+    if (current_pool == state) {
+        if (zthread_job_queue_pop_back(&state->queues[current_worker], out_job)) {
+            zatomic_fetch_add_i32(&state->pending_jobs, -1);
+            return true;
+        }
+        start = current_worker + 1;
+    }
+    for (u32 i = 0; i < state->thread_count; ++i) {
+        u32 victim = (start + i) % state->thread_count;
+        if (zthread_job_queue_steal_front(&state->queues[victim], out_job)) {
+            zatomic_fetch_add_i32(&state->pending_jobs, -1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void zthread_pool_run_job(zthread_job* job) {
+    job->func(job->params);
+    if (job->group) {
+        zthread_wait_group_state* group = job->group->internal_data;
+        pthread_mutex_lock(&group->mutex);
+        if (--group->count == 0) {
+            pthread_cond_broadcast(&group->cond);
+        }
+        pthread_mutex_unlock(&group->mutex);
+    }
+}
+
+void* zthread_pool_worker(void* params) {
+    zthread_worker_params* worker = params;
+    zthread_pool_state* state = worker->state;
+    current_pool = state;
+    current_worker = worker->index;
+    zmemory_free(worker, sizeof(zthread_worker_params));
+
+    zthread_job job;
+    while (true) {
+        if (zthread_pool_take_job(state, &job)) {
+            zthread_pool_run_job(&job);
+            continue;
+        }
+        pthread_mutex_lock(&state->sleep_mutex);
+        while (zatomic_load_i32(&state->pending_jobs) <= 0 && zatomic_load_i32(&state->running)) {
+            pthread_cond_wait(&state->sleep_cond, &state->sleep_mutex);
+        }
+        pthread_mutex_unlock(&state->sleep_mutex);
+        // queued jobs are always finished before the worker exits
+        if (!zatomic_load_i32(&state->running) && zatomic_load_i32(&state->pending_jobs) <= 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/// queue_count is the number of queues that were set up, zthread_pool_create can fail half way
+void zthread_pool_free_state(zthread_pool_state* state, u32 queue_count) {
+    for (u32 i = 0; i < queue_count; ++i) {
+        pthread_mutex_destroy(&state->queues[i].mutex);
+        zmemory_free(state->queues[i].jobs, sizeof(zthread_job) * state->queues[i].capacity);
+    }
+    pthread_mutex_destroy(&state->sleep_mutex);
+    pthread_cond_destroy(&state->sleep_cond);
+    if (state->queues) {
+        zmemory_free(state->queues, sizeof(zthread_job_queue) * state->thread_count);
+    }
+    if (state->threads) {
+        zmemory_free(state->threads, sizeof(pthread_t) * state->thread_count);
+    }
+    zmemory_free(state, sizeof(zthread_pool_state));
+}
+
+void zthread_pool_join(zthread_pool_state* state, u32 count) {
+    pthread_mutex_lock(&state->sleep_mutex);
+    zatomic_store_i32(&state->running, 0);
+    pthread_cond_broadcast(&state->sleep_cond);
+    pthread_mutex_unlock(&state->sleep_mutex);
+
+    for (u32 i = 0; i < count; ++i) {
+        if (0 != pthread_join(state->threads[i], 0)) {
+            LOGW("zthread_pool: failed to join worker");
+        }
+    }
+}
+
+bool zthread_pool_create(u32 thread_count, zthread_pool* out_pool) {
+    if (0 == out_pool) {
+        LOGE("zthread_pool_create: invalid params");
+        return false;
+    }
+    if (thread_count == 0) {
+        thread_count = platform_get_processor_count();
+        thread_count = (thread_count ? thread_count : 1);
+    }
+
+    zthread_pool_state* state = zmemory_allocate(sizeof(zthread_pool_state));
+    if (0 == state) {
+        LOGE("zthread_pool_create: failed to allocate the pool");
+        return false;
+    }
+    state->thread_count = thread_count;
+    state->running = 1;
+    pthread_mutex_init(&state->sleep_mutex, 0);
+    pthread_cond_init(&state->sleep_cond, 0);
+    state->threads = zmemory_allocate(sizeof(pthread_t) * thread_count);
+    state->queues = zmemory_allocate(sizeof(zthread_job_queue) * thread_count);
+    if (0 == state->threads || 0 == state->queues) {
+        LOGE("zthread_pool_create: failed to allocate the worker queues");
+        zthread_pool_free_state(state, 0);
+        return false;
+    }
+    for (u32 i = 0; i < thread_count; ++i) {
+        state->queues[i].capacity = ZTHREAD_JOB_QUEUE_DEFAULT_CAPACITY;
+        state->queues[i].jobs = zmemory_allocate(sizeof(zthread_job) * ZTHREAD_JOB_QUEUE_DEFAULT_CAPACITY);
+        if (0 == state->queues[i].jobs) {
+            LOGE("zthread_pool_create: failed to allocate a job queue");
+            zthread_pool_free_state(state, i);
+            return false;
+        }
+        pthread_mutex_init(&state->queues[i].mutex, 0);
+    }
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        zthread_worker_params* worker = zmemory_allocate(sizeof(zthread_worker_params));
+        if (0 == worker) {
+            LOGE("zthread_pool_create: failed to allocate worker params");
+            zthread_pool_join(state, i);
+            zthread_pool_free_state(state, thread_count);
+            return false;
+        }
+        worker->state = state;
+        worker->index = i;
+        if (0 != pthread_create(&state->threads[i], 0, zthread_pool_worker, worker)) {
+            LOGE("zthread_pool_create: failed to create worker thread");
+            zmemory_free(worker, sizeof(zthread_worker_params));
+            zthread_pool_join(state, i);
+            zthread_pool_free_state(state, thread_count);
+            return false;
+        }
+    }
+
+    out_pool->internal_data = state;
+    return true;
+}
+
+void zthread_pool_destroy(zthread_pool* pool) {
+    if (0 == pool || 0 == pool->internal_data) {
+        LOGE("zthread_pool_destroy: invalid params");
+        return;
+    }
+    zthread_pool_state* state = pool->internal_data;
+    zthread_pool_join(state, state->thread_count);
+    zthread_pool_free_state(state, state->thread_count);
+    pool->internal_data = 0;
+}
+
+u32 zthread_pool_thread_count(zthread_pool* pool) {
+    if (0 == pool || 0 == pool->internal_data) {
+        LOGE("zthread_pool_thread_count: invalid params");
+        return 0;
+    }
+    return ((zthread_pool_state*)pool->internal_data)->thread_count;
+}
+
+bool zthread_pool_submit(zthread_pool* pool, PFN_zthread_job job, void* params, zthread_wait_group* group) {
+    if (0 == pool || 0 == pool->internal_data || 0 == job) {
+        LOGE("zthread_pool_submit: invalid params");
+        return false;
+    }
+    zthread_pool_state* state = pool->internal_data;
+    u32 queue = (current_pool == state ? current_worker : (u32)zatomic_fetch_add_i32(&state->next_queue, 1) % state->thread_count);
+
+    if (group) {
+        zthread_wait_group_state* group_state = group->internal_data;
+        pthread_mutex_lock(&group_state->mutex);
+        group_state->count++;
+        pthread_mutex_unlock(&group_state->mutex);
+    }
+    if (!zthread_job_queue_push(&state->queues[queue], (zthread_job){job, params, group})) {
+        LOGE("zthread_pool_submit: failed to queue the job, running it on the calling thread");
+        zthread_pool_run_job(&(zthread_job){job, params, group});
+        return true;
+    }
+
+    zatomic_fetch_add_i32(&state->pending_jobs, 1);
+    pthread_mutex_lock(&state->sleep_mutex);
+    pthread_cond_signal(&state->sleep_cond);
+    pthread_mutex_unlock(&state->sleep_mutex);
+    return true;
+}
+
+bool zthread_pool_wait(zthread_pool* pool, zthread_wait_group* group) {
+    if (0 == pool || 0 == pool->internal_data || 0 == group || 0 == group->internal_data) {
+        LOGE("zthread_pool_wait: invalid params");
+        return false;
+    }
+    zthread_pool_state* state = pool->internal_data;
+    zthread_wait_group_state* group_state = group->internal_data;
+    zthread_job job;
+
+    pthread_mutex_lock(&group_state->mutex);
+    while (group_state->count > 0) {
+        pthread_mutex_unlock(&group_state->mutex);
+        // help with the queued jobs instead of just blocking
+        if (zthread_pool_take_job(state, &job)) {
+            zthread_pool_run_job(&job);
+            pthread_mutex_lock(&group_state->mutex);
+            continue;
+        }
+        pthread_mutex_lock(&group_state->mutex);
+        if (group_state->count > 0) {
+            // timed so new jobs (submitted by running jobs) get picked up again
+            struct timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += ZTHREAD_POOL_WAIT_TIMEOUT_NS;
+            if (timeout.tv_nsec >= 1000000000) {
+                timeout.tv_sec += 1;
+                timeout.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&group_state->cond, &group_state->mutex, &timeout);
+        }
+    }
+    pthread_mutex_unlock(&group_state->mutex);
+    return true;
+}
+
+bool zthread_wait_group_create(zthread_wait_group* out_group) {
+    if (0 == out_group) {
+        LOGE("zthread_wait_group_create: invalid params");
+        return false;
+    }
+    zthread_wait_group_state* state = zmemory_allocate(sizeof(zthread_wait_group_state));
+    if (0 != pthread_mutex_init(&state->mutex, 0) || 0 != pthread_cond_init(&state->cond, 0)) {
+        LOGE("zthread_wait_group_create: failed to create wait group");
+        zmemory_free(state, sizeof(zthread_wait_group_state));
+        return false;
+    }
+    out_group->internal_data = state;
+    return true;
+}
+
+void zthread_wait_group_destroy(zthread_wait_group* group) {
+    if (0 == group || 0 == group->internal_data) {
+        LOGE("zthread_wait_group_destroy: invalid params");
+        return;
+    }
+    zthread_wait_group_state* state = group->internal_data;
+    pthread_mutex_destroy(&state->mutex);
+    pthread_cond_destroy(&state->cond);
+    zmemory_free(state, sizeof(zthread_wait_group_state));
+    group->internal_data = 0;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef ZATOMIC__H
+#define ZATOMIC__H
+
+#include "defines.h"
+
+/**
+ * @brief thin wrappers over the compiler atomic builtins (clang and gcc on both platforms)
+ * used for lock free counters shared between zthreads
+ */
+
+INLINE i32 zatomic_load_i32(volatile i32* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+INLINE void zatomic_store_i32(volatile i32* value, i32 new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+/// returns the value before the addition
+INLINE i32 zatomic_fetch_add_i32(volatile i32* value, i32 addend) {
+    return __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+}
+
+/// returns the value before the addition
+INLINE i64 zatomic_fetch_add_i64(volatile i64* value, i64 addend) {
+    return __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+}
+
+#endif
@@ -10,7 +10,7 @@ typedef struct zthread {
 #ifdef PLATFORM_WINDOWS
 typedef unsigned long zthread_func_return_type;
 #else
-typedef void* zthread_fun_return_type;
+typedef void* zthread_func_return_type;
 #endif
 
 typedef zthread_func_return_type (*PFN_zthread_start_func)(void*);
@@ -0,0 +1,67 @@
+#ifndef ZTHREAD_POOL__H
+#define ZTHREAD_POOL__H
+
+#include "defines.h"
+
+/**
+ * @brief persistent pool of worker threads
+ * every worker owns a job queue, jobs submitted from a worker go to its own queue (run newest first)
+ * and idle workers steal the oldest jobs from the other queues
+ * jobs submitted from outside the pool are spread over the queues round robin
+ */
+
+typedef struct zthread_pool {
+    void* internal_data;
+} zthread_pool;
+
+/**
+ * @brief counts the jobs submitted with it that have not finished yet
+ * a wait group with one job works as a future for that job
+ */
+typedef struct zthread_wait_group {
+    void* internal_data;
+} zthread_wait_group;
+
+typedef void (*PFN_zthread_job)(void* params);
+
+/// thread_count = 0 will create one worker per available processor
+bool zthread_pool_create(u32 thread_count, zthread_pool* out_pool);
+
+/// waits for the queued jobs to finish and joins the workers
+void zthread_pool_destroy(zthread_pool* pool);
+
+u32 zthread_pool_thread_count(zthread_pool* pool);
+
+/// group can be 0 if no one needs to wait for the job
+bool zthread_pool_submit(zthread_pool* pool, PFN_zthread_job job, void* params, zthread_wait_group* group);
+
+/// blocks until every job of the group has finished, the calling thread runs queued jobs while waiting
+/// so it is safe to wait from inside a job (nested parallelism)
+bool zthread_pool_wait(zthread_pool* pool, zthread_wait_group* group);
+
+bool zthread_wait_group_create(zthread_wait_group* out_group);
+
+void zthread_wait_group_destroy(zthread_wait_group* group);
+
+/**
+ * @brief runs job on each of the count items (item_size bytes apart) and waits for them all
+ * runs them on the calling thread when pool is 0, there is a single item or the pool can't take them
+ */
+INLINE void zthread_pool_parallel_for(zthread_pool* pool, void* items, u64 item_size, u32 count, PFN_zthread_job job) {
+    zthread_wait_group group;
+    if (pool == 0 || count == 1 || !zthread_wait_group_create(&group)) {
+        for (u32 i = 0; i < count; ++i) {
+            job((u8*)items + i * item_size);
+        }
+        return;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        if (!zthread_pool_submit(pool, job, (u8*)items + i * item_size, &group)) {
+            job((u8*)items + i * item_size);
+        }
+    }
+    zthread_pool_wait(pool, &group);
+    zthread_wait_group_destroy(&group);
+}
+
+#endif
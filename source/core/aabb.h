@@ -14,17 +14,17 @@ typedef struct aabb {
 INLINE void aabb_pad_to_minimums(aabb* box) {
     f64 delta = 0.0001;
     if (interval_size(box->x_range) < delta)
-        interval_expand(box->x_range, delta);
+        box->x_range = interval_expand(box->x_range, delta);
     if (interval_size(box->y_range) < delta)
-        interval_expand(box->y_range, delta);
+        box->y_range = interval_expand(box->y_range, delta);
     if (interval_size(box->z_range) < delta)
-        interval_expand(box->z_range, delta);
+        box->z_range = interval_expand(box->z_range, delta);
 }
 
 INLINE aabb aabb_expand(aabb box, f64 val) {
-    interval_expand(box.x_range, val);
-    interval_expand(box.y_range, val);
-    interval_expand(box.z_range, val);
+    box.x_range = interval_expand(box.x_range, val);
+    box.y_range = interval_expand(box.y_range, val);
+    box.z_range = interval_expand(box.z_range, val);
     return box;
 }
 
@@ -70,6 +70,24 @@ INLINE i32 aabb_longest_axis(aabb* box) {
                                           : 2;
 }
 
+INLINE f64 aabb_surface_area(aabb* box) {
+    f64 x = interval_size(box->x_range);
+    f64 y = interval_size(box->y_range);
+    f64 z = interval_size(box->z_range);
+    if (x < 0.0 || y < 0.0 || z < 0.0) { // empty box
+        return 0.0;
+    }
+    return 2.0 * (x * y + y * z + z * x);
+}
+
+INLINE point3 aabb_centroid(aabb* box) {
+    return (point3){
+        (box->x_range.min + box->x_range.max) * 0.5,
+        (box->y_range.min + box->y_range.max) * 0.5,
+        (box->z_range.min + box->z_range.max) * 0.5,
+    };
+}
+
 INLINE aabb aabb_translate(aabb* box, vec3 offset) {
     return (aabb){
         interval_displace(box->x_range, offset.x),
@@ -78,34 +96,38 @@ INLINE aabb aabb_translate(aabb* box, vec3 offset) {
     };
 }
 
-INLINE bool aabb_hit(aabb* box, ray* r, interval r_t) {
-
-    point3 origin = r->origin;
-    vec3 dir = r->direction;
-
-    for (i32 i = 0; i < 3; ++i) {
-        interval axis_range = aabb_axis_interval(box, i);
-        f64 inv_dir = 1.0 / vec3_axis(dir, i);
-        f64 t0 = (axis_range.min - vec3_axis(origin, i)) * inv_dir;
-        f64 t1 = (axis_range.max - vec3_axis(origin, i)) * inv_dir;
-
-        if (t0 < t1) {
-            if (t0 > r_t.min)
-                r_t.min = t0;
-            if (t1 < r_t.max)
-                r_t.max = t1;
-        } else {
-            if (t0 < r_t.min)
-                r_t.min = t0;
-            if (t1 > r_t.max)
-                r_t.max = t1;
-        }
-
-        if (r_t.max <= r_t.min) {
-            return false;
-        }
+// bounds of the 8 transformed corners of the box
+INLINE aabb aabb_transform(aabb* box, const mat3x4* mtx) {
+    aabb result = aabb_create_empty();
+    for (i32 i = 0; i < 8; ++i) {
+        point3 corner = {
+            (i & 1) ? box->x_range.max : box->x_range.min,
+            (i & 2) ? box->y_range.max : box->y_range.min,
+            (i & 4) ? box->z_range.max : box->z_range.min,
+        };
+        point3 p = mat3x4_mul_point(mtx, corner);
+        result = aabb_merge(result, (aabb){{p.x, p.x}, {p.y, p.y}, {p.z, p.z}});
     }
-    return true;
+    aabb_pad_to_minimums(&result);
+    return result;
+}
+
+// branchless slab test, the ray's sign picks the near and far bound of every axis ({min, max}[sign])
+INLINE bool aabb_hit(aabb* box, ray* r, interval r_t) {
+    const f64* x = &box->x_range.min;
+    const f64* y = &box->y_range.min;
+    const f64* z = &box->z_range.min;
+
+    f64 tx_near = (x[r->sign[0]] - r->origin.x) * r->inv_direction.x;
+    f64 tx_far = (x[1 - r->sign[0]] - r->origin.x) * r->inv_direction.x;
+    f64 ty_near = (y[r->sign[1]] - r->origin.y) * r->inv_direction.y;
+    f64 ty_far = (y[1 - r->sign[1]] - r->origin.y) * r->inv_direction.y;
+    f64 tz_near = (z[r->sign[2]] - r->origin.z) * r->inv_direction.z;
+    f64 tz_far = (z[1 - r->sign[2]] - r->origin.z) * r->inv_direction.z;
+
+    f64 t_min = MAX(MAX(tx_near, ty_near), MAX(tz_near, r_t.min));
+    f64 t_max = MIN(MIN(tx_far, ty_far), MIN(tz_far, r_t.max));
+    return t_min <= t_max;
 }
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "zmemory.h"
 #include "logger.h"
 #include "darray.h"
+#include "asserts.h"
 
 /////////////////////////////////////
 //  __                   __        //
@@ -17,18 +18,47 @@
 //                                 //
 /////////////////////////////////////
 
-typedef struct bvh {
+#define BVH_SAH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_TRAVERSAL_COST 1.0
+#define BVH_INTERSECTION_COST 1.0
+#define LINEAR_BVH_STACK_SIZE 64
+
+// 32 bytes, nodes are stored depth first so the first child of an inner node is always the next node
+typedef struct linear_bvh_node {
+    f32 bounds[2][3]; // min, max (indexed by the ray's direction sign)
+    u32 offset;       // leaf: first object index, inner: index of the second child
+    u16 object_count; // 0 for inner nodes
+    u8 axis;          // split axis of inner nodes
+    u8 pad;
+} linear_bvh_node;
+
+STATIC_ASSERT(sizeof(linear_bvh_node) == 32);
+
+typedef struct linear_bvh {
     hittable base;
-    hittable* left;
-    hittable* right;
-    bool is_leaf;
-} bvh;
+    linear_bvh_node* nodes;
+    hittable** objects;
+    u32 node_count;
+    u32 object_count;
+} linear_bvh;
+
+typedef struct bvh_bin {
+    aabb box;
+    i32 count;
+} bvh_bin;
+
 // global
 hittable* create_bvh(hittable** darray, i32 start, i32 end);
+hittable* create_bvh_sah(hittable** objects, i32 start, i32 end);
+hittable* create_bvh_leaf(hittable** objects, i32 start, i32 end, aabb box);
 void destroy_bvh(hittable* node);
+f64 sah_cost(hittable* node, f64 inv_root_area);
+void count_bvh(hittable* node, u32 depth, u32* node_count, u32* object_count, u32* max_depth);
+void flatten_bvh(hittable* node, linear_bvh* out, u32* node_index, u32* object_index);
 
 hittable* bvh_create(hittable** darray) {
-    if (darray == 0) {
+    if (darray == 0 || darray_length(darray) == 0) {
         LOGE("bvh_create: invalid params ");
         return 0;
     }
@@ -36,26 +66,218 @@ hittable* bvh_create(hittable** darray) {
     return create_bvh(darray, 0, darray_length(darray));
 }
 
+hittable* bvh_create_sah(hittable** darray) {
+    if (darray == 0 || darray_length(darray) == 0) {
+        LOGE("bvh_create_sah: invalid params ");
+        return 0;
+    }
+    // the builder partitions the objects in place, work on a copy so the caller's order is kept
+    u64 count = darray_length(darray);
+    hittable** objects = zmemory_allocate(count * sizeof(hittable*));
+    zmemory_copy(objects, darray, count * sizeof(hittable*));
+    hittable* root = create_bvh_sah(objects, 0, count);
+    zmemory_free(objects, count * sizeof(hittable*));
+    return root;
+}
+
 void bvh_destroy(hittable* bvh) {
     destroy_bvh(bvh);
 }
 
+void bvh_count(hittable* bvh, u32* out_node_count, u32* out_object_count, u32* out_depth) {
+    if (bvh == 0 || out_node_count == 0 || out_object_count == 0 || out_depth == 0) {
+        LOGE("bvh_count: invalid params");
+        return;
+    }
+    *out_node_count = 0;
+    *out_object_count = 0;
+    *out_depth = 0;
+    count_bvh(bvh, 1, out_node_count, out_object_count, out_depth);
+}
+
+f64 bvh_sah_cost(hittable* bvh) {
+    if (bvh == 0) {
+        LOGE("bvh_sah_cost: invalid params");
+        return 0.0;
+    }
+    f64 root_area = aabb_surface_area(&bvh->box);
+    return sah_cost(bvh, root_area > 0.0 ? 1.0 / root_area : 0.0);
+}
+
 bool bvh_hit(hittable* bvh_object, ray* r_in, interval r_t, hit_record* record) {
     if (!aabb_hit(&bvh_object->box, r_in, r_t)) {
         return false;
     }
     bvh* volume = (bvh*)bvh_object;
-    bool hit_left = 0;
-    bool hit_right = 0;
-    if (volume->left != 0) {
-        hit_left = volume->left->hit(volume->left, r_in, r_t, record);
-    }
-    if (volume->right != 0) {
-        hit_right = volume->right->hit(volume->right, r_in, (interval){r_t.min, (hit_left ? record->t : r_t.max)}, record);
+    if (volume->object_count != 0) {
+        bool hit_anything = false;
+        for (u32 i = 0; i < volume->object_count; ++i) {
+            hittable* object = volume->objects[i];
+            if (object->hit(object, r_in, r_t, record)) {
+                hit_anything = true;
+                r_t.max = record->t;
+            }
+        }
+        return hit_anything;
     }
+    bool hit_left = volume->left->hit(volume->left, r_in, r_t, record);
+    bool hit_right = volume->right->hit(volume->right, r_in, (interval){r_t.min, (hit_left ? record->t : r_t.max)}, record);
     return hit_left || hit_right;
 }
 
+bool bvh_occluded(hittable* bvh_object, ray* r_in, interval r_t) {
+    if (!aabb_hit(&bvh_object->box, r_in, r_t)) {
+        return false;
+    }
+    bvh* volume = (bvh*)bvh_object;
+    if (volume->object_count != 0) {
+        for (u32 i = 0; i < volume->object_count; ++i) {
+            hittable* object = volume->objects[i];
+            if (object->occluded(object, r_in, r_t)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return volume->left->occluded(volume->left, r_in, r_t) || volume->right->occluded(volume->right, r_in, r_t);
+}
+
+hittable* linear_bvh_create(hittable* bvh) {
+    if (bvh == 0 || bvh->hit != bvh_hit) {
+        LOGE("linear_bvh_create: invalid params");
+        return 0;
+    }
+    u32 node_count = 0;
+    u32 object_count = 0;
+    u32 max_depth = 0;
+    bvh_count(bvh, &node_count, &object_count, &max_depth);
+    if (max_depth > LINEAR_BVH_STACK_SIZE) {
+        LOGE("linear_bvh_create: bvh is too deep (%u levels)", max_depth);
+        return 0;
+    }
+
+    linear_bvh* temp = zmemory_allocate(sizeof(linear_bvh));
+    temp->base.hit = linear_bvh_hit;
+    temp->base.occluded = linear_bvh_occluded;
+    temp->base.box = bvh->box;
+    temp->nodes = zmemory_allocate(node_count * sizeof(linear_bvh_node));
+    temp->objects = zmemory_allocate(object_count * sizeof(hittable*));
+    temp->node_count = node_count;
+    temp->object_count = object_count;
+
+    u32 node_index = 0;
+    u32 object_index = 0;
+    flatten_bvh(bvh, temp, &node_index, &object_index);
+    return (hittable*)temp;
+}
+
+void linear_bvh_destroy(hittable* linear) {
+    if (linear == 0) {
+        LOGE("linear_bvh_destroy: invalid params");
+        return;
+    }
+    linear_bvh* temp = (linear_bvh*)linear;
+    zmemory_free(temp->nodes, temp->node_count * sizeof(linear_bvh_node));
+    zmemory_free(temp->objects, temp->object_count * sizeof(hittable*));
+    zmemory_free(temp, sizeof(linear_bvh));
+}
+
+bool linear_bvh_hit(hittable* linear, ray* r_in, interval r_t, hit_record* record) {
+    linear_bvh* temp = (linear_bvh*)linear;
+    f64 origin[3] = {r_in->origin.x, r_in->origin.y, r_in->origin.z};
+    f64 inv_dir[3] = {r_in->inv_direction.x, r_in->inv_direction.y, r_in->inv_direction.z};
+    const i32* sign = r_in->sign;
+
+    u32 stack[LINEAR_BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 current = 0;
+    bool hit_anything = false;
+    for (;;) {
+        linear_bvh_node* node = temp->nodes + current;
+
+        // slab test, the near plane of every axis is picked from the direction sign
+        f64 tx_near = (node->bounds[sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 tx_far = (node->bounds[1 - sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 ty_near = (node->bounds[sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 ty_far = (node->bounds[1 - sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 tz_near = (node->bounds[sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 tz_far = (node->bounds[1 - sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 t_min = MAX(MAX(tx_near, ty_near), MAX(tz_near, r_t.min));
+        f64 t_max = MIN(MIN(tx_far, ty_far), MIN(tz_far, r_t.max));
+
+        if (t_min <= t_max) {
+            if (node->object_count != 0) {
+                for (u32 i = 0; i < node->object_count; ++i) {
+                    hittable* object = temp->objects[node->offset + i];
+                    if (object->hit(object, r_in, r_t, record)) {
+                        hit_anything = true;
+                        r_t.max = record->t;
+                    }
+                }
+            } else {
+                // visit the child on the ray's side of the split first, the far one waits on the stack
+                if (sign[node->axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node->offset;
+                } else {
+                    stack[stack_size++] = node->offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+    return hit_anything;
+}
+
+bool linear_bvh_occluded(hittable* linear, ray* r_in, interval r_t) {
+    linear_bvh* temp = (linear_bvh*)linear;
+    f64 origin[3] = {r_in->origin.x, r_in->origin.y, r_in->origin.z};
+    f64 inv_dir[3] = {r_in->inv_direction.x, r_in->inv_direction.y, r_in->inv_direction.z};
+    const i32* sign = r_in->sign;
+
+    u32 stack[LINEAR_BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 current = 0;
+    for (;;) {
+        linear_bvh_node* node = temp->nodes + current;
+
+        f64 tx_near = (node->bounds[sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 tx_far = (node->bounds[1 - sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 ty_near = (node->bounds[sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 ty_far = (node->bounds[1 - sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 tz_near = (node->bounds[sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 tz_far = (node->bounds[1 - sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 t_min = MAX(MAX(tx_near, ty_near), MAX(tz_near, r_t.min));
+        f64 t_max = MIN(MIN(tx_far, ty_far), MIN(tz_far, r_t.max));
+
+        if (t_min <= t_max) {
+            if (node->object_count != 0) {
+                for (u32 i = 0; i < node->object_count; ++i) {
+                    hittable* object = temp->objects[node->offset + i];
+                    if (object->occluded(object, r_in, r_t)) {
+                        return true;
+                    }
+                }
+            } else {
+                // any hit ends the search so the children are visited in storage order
+                stack[stack_size++] = node->offset;
+                current = current + 1;
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+    return false;
+}
+
 //////////////////////////////////////////////////////////////////////
 //  __                  __                                          //
 // /  |                /  |                                         //
@@ -102,33 +324,143 @@ int cmp_z_axis(const void* a, const void* b) {
 
 hittable* create_bvh(hittable** darray, i32 start, i32 end) {
 
+    aabb box = aabb_create_empty();
+    for (i32 i = start; i < end; ++i) {
+        box = aabb_merge(darray[i]->box, box);
+    }
+
+    i32 object_span = end - start;
+    if (object_span <= 2) {
+        return create_bvh_leaf(darray, start, end, box);
+    }
+
+    i32 longest_axis = aabb_longest_axis(&box);
+    qsort_cmp cmp = (longest_axis == 0 ? cmp_x_axis : ((longest_axis == 1) ? cmp_y_axis : cmp_z_axis));
+    quick_sort(darray + start, object_span, sizeof(hittable*), cmp);
+
     bvh* temp = zmemory_allocate(sizeof(bvh));
     temp->base.hit = bvh_hit;
-    temp->base.box = aabb_create_empty();
-    temp->left = 0;
-    temp->right = 0;
-    temp->is_leaf = 0;
+    temp->base.occluded = bvh_occluded;
+    temp->base.box = box;
+    temp->axis = longest_axis;
+    i32 mid = start + object_span / 2;
+    temp->left = create_bvh(darray, start, mid);
+    temp->right = create_bvh(darray, mid, end);
+    return (hittable*)temp;
+}
+
+hittable* create_bvh_sah(hittable** objects, i32 start, i32 end) {
+
+    aabb box = aabb_create_empty();
+    aabb centroid_box = aabb_create_empty();
     for (i32 i = start; i < end; ++i) {
-        temp->base.box = aabb_merge(darray[i]->box, temp->base.box);
+        box = aabb_merge(objects[i]->box, box);
+        point3 c = aabb_centroid(&objects[i]->box);
+        centroid_box = aabb_merge((aabb){{c.x, c.x}, {c.y, c.y}, {c.z, c.z}}, centroid_box);
     }
 
-    i32 longest_axis = aabb_longest_axis(&temp->base.box);
-    qsort_cmp cmp = (longest_axis == 0 ? cmp_x_axis : ((longest_axis == 1) ? cmp_y_axis : cmp_z_axis));
     i32 object_span = end - start;
-
     if (object_span == 1) {
-        temp->left = darray[start];
-        temp->is_leaf = 1;
-    } else if (object_span == 2) {
-        temp->left = darray[start];
-        temp->right = darray[start + 1];
-        temp->is_leaf = 1;
+        return create_bvh_leaf(objects, start, end, box);
+    }
+
+    // bin the centroids along every axis and sweep the bin boundaries for the cheapest split
+    // cost = traversal + (area_left * count_left + area_right * count_right) / area * intersection
+    f64 inv_area = 1.0 / aabb_surface_area(&box);
+    f64 best_cost = INFINITY;
+    i32 best_axis = -1;
+    i32 best_split = 0;
+    for (i32 axis = 0; axis < 3; ++axis) {
+        interval range = aabb_axis_interval(&centroid_box, axis);
+        f64 extent = interval_size(range);
+        if (!(extent > 0.0)) {
+            continue; // all the centroids are on the same plane
+        }
+        f64 bin_scale = BVH_SAH_BIN_COUNT / extent;
+
+        bvh_bin bins[BVH_SAH_BIN_COUNT];
+        for (i32 b = 0; b < BVH_SAH_BIN_COUNT; ++b) {
+            bins[b] = (bvh_bin){aabb_create_empty(), 0};
+        }
+        for (i32 i = start; i < end; ++i) {
+            point3 c = aabb_centroid(&objects[i]->box);
+            i32 b = (i32)((vec3_axis(c, axis) - range.min) * bin_scale);
+            b = CLAMP(0, BVH_SAH_BIN_COUNT - 1, b);
+            bins[b].count++;
+            bins[b].box = aabb_merge(objects[i]->box, bins[b].box);
+        }
+
+        // right to left sweep stores the cost of the right side of every split
+        f64 right_cost[BVH_SAH_BIN_COUNT];
+        aabb right_box = aabb_create_empty();
+        i32 right_count = 0;
+        for (i32 b = BVH_SAH_BIN_COUNT - 1; b > 0; --b) {
+            right_box = aabb_merge(bins[b].box, right_box);
+            right_count += bins[b].count;
+            right_cost[b] = right_count * aabb_surface_area(&right_box);
+        }
+        aabb left_box = aabb_create_empty();
+        i32 left_count = 0;
+        for (i32 b = 0; b < BVH_SAH_BIN_COUNT - 1; ++b) {
+            left_box = aabb_merge(bins[b].box, left_box);
+            left_count += bins[b].count;
+            if (left_count == 0 || left_count == object_span) {
+                continue;
+            }
+            f64 cost = BVH_TRAVERSAL_COST +
+                       (left_count * aabb_surface_area(&left_box) + right_cost[b + 1]) * inv_area * BVH_INTERSECTION_COST;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    // small nodes become leaves when splitting them doesn't pay off
+    f64 leaf_cost = object_span * BVH_INTERSECTION_COST;
+    if (object_span <= BVH_MAX_LEAF_SIZE && (best_axis < 0 || leaf_cost <= best_cost)) {
+        return create_bvh_leaf(objects, start, end, box);
+    }
+
+    i32 mid = start;
+    if (best_axis < 0) {
+        // every centroid is the same point, there is nothing to bin, split by count
+        best_axis = aabb_longest_axis(&box);
+        mid = start + object_span / 2;
     } else {
-        quick_sort(darray + start, object_span, sizeof(hittable*), cmp);
-        i32 mid = start + object_span / 2;
-        temp->left = create_bvh(darray, start, mid);
-        temp->right = create_bvh(darray, mid, end);
+        interval range = aabb_axis_interval(&centroid_box, best_axis);
+        f64 bin_scale = BVH_SAH_BIN_COUNT / interval_size(range);
+        for (i32 i = start; i < end; ++i) {
+            point3 c = aabb_centroid(&objects[i]->box);
+            i32 b = (i32)((vec3_axis(c, best_axis) - range.min) * bin_scale);
+            b = CLAMP(0, BVH_SAH_BIN_COUNT - 1, b);
+            if (b < best_split) {
+                hittable* swap = objects[i];
+                objects[i] = objects[mid];
+                objects[mid++] = swap;
+            }
+        }
     }
+
+    bvh* temp = zmemory_allocate(sizeof(bvh));
+    temp->base.hit = bvh_hit;
+    temp->base.occluded = bvh_occluded;
+    temp->base.box = box;
+    temp->axis = best_axis;
+    temp->left = create_bvh_sah(objects, start, mid);
+    temp->right = create_bvh_sah(objects, mid, end);
+    return (hittable*)temp;
+}
+
+hittable* create_bvh_leaf(hittable** objects, i32 start, i32 end, aabb box) {
+    bvh* temp = zmemory_allocate(sizeof(bvh));
+    temp->base.hit = bvh_hit;
+    temp->base.occluded = bvh_occluded;
+    temp->base.box = box;
+    temp->object_count = end - start;
+    temp->objects = zmemory_allocate(temp->object_count * sizeof(hittable*));
+    zmemory_copy(temp->objects, objects + start, temp->object_count * sizeof(hittable*));
     return (hittable*)temp;
 }
 
@@ -136,9 +468,63 @@ void destroy_bvh(hittable* node) {
     if (node == 0)
         return;
     bvh* temp = (bvh*)node;
-    if (!temp->is_leaf) {
+    if (temp->block != 0) {
+        bvh_block* block = temp->block;
+        zmemory_free(block->nodes, block->node_count * sizeof(bvh));
+        zmemory_free(block->objects, block->object_count * sizeof(hittable*));
+        zmemory_free(block, sizeof(bvh_block));
+        return;
+    }
+    if (temp->object_count == 0) {
         destroy_bvh(temp->left);
         destroy_bvh(temp->right);
+    } else {
+        zmemory_free(temp->objects, temp->object_count * sizeof(hittable*));
     }
     zmemory_free(temp, sizeof(bvh));
 }
+
+f64 sah_cost(hittable* node, f64 inv_root_area) {
+    bvh* temp = (bvh*)node;
+    f64 area_ratio = aabb_surface_area(&node->box) * inv_root_area;
+    if (temp->object_count != 0) {
+        return area_ratio * temp->object_count * BVH_INTERSECTION_COST;
+    }
+    return area_ratio * BVH_TRAVERSAL_COST + sah_cost(temp->left, inv_root_area) + sah_cost(temp->right, inv_root_area);
+}
+
+void count_bvh(hittable* node, u32 depth, u32* node_count, u32* object_count, u32* max_depth) {
+    bvh* temp = (bvh*)node;
+    (*node_count)++;
+    *max_depth = depth > *max_depth ? depth : *max_depth;
+    if (temp->object_count != 0) {
+        *object_count += temp->object_count;
+        return;
+    }
+    count_bvh(temp->left, depth + 1, node_count, object_count, max_depth);
+    count_bvh(temp->right, depth + 1, node_count, object_count, max_depth);
+}
+
+void flatten_bvh(hittable* node, linear_bvh* out, u32* node_index, u32* object_index) {
+    bvh* temp = (bvh*)node;
+    linear_bvh_node* flat = out->nodes + (*node_index)++;
+    flat->bounds[0][0] = zfloat_round_down(node->box.x_range.min);
+    flat->bounds[0][1] = zfloat_round_down(node->box.y_range.min);
+    flat->bounds[0][2] = zfloat_round_down(node->box.z_range.min);
+    flat->bounds[1][0] = zfloat_round_up(node->box.x_range.max);
+    flat->bounds[1][1] = zfloat_round_up(node->box.y_range.max);
+    flat->bounds[1][2] = zfloat_round_up(node->box.z_range.max);
+
+    if (temp->object_count != 0) {
+        flat->offset = *object_index;
+        flat->object_count = temp->object_count;
+        for (u32 i = 0; i < temp->object_count; ++i) {
+            out->objects[(*object_index)++] = temp->objects[i];
+        }
+        return;
+    }
+    flat->axis = temp->axis;
+    flatten_bvh(temp->left, out, node_index, object_index);
+    flat->offset = *node_index;
+    flatten_bvh(temp->right, out, node_index, object_index);
+}
@@ -6,11 +6,65 @@
 #include "ray.h"
 #include "aabb.h"
 #include "hittable.h"
+#include "zthread_pool.h"
 
+/// trees from bvh_create_lbvh keep all their nodes and leaf lists in one allocation
+typedef struct bvh_block {
+    struct bvh* nodes;
+    hittable** objects;
+    u32 node_count;
+    u32 object_count;
+} bvh_block;
+
+/// binary tree node, the other layouts (linear_bvh, bvh_wide) are built from it
+typedef struct bvh {
+    hittable base;
+    hittable* left;
+    hittable* right;
+    hittable** objects; // leaf only
+    u32 object_count;   // 0 for inner nodes
+    u32 axis;           // split axis of inner nodes
+    bvh_block* block;   // root only, 0 when the nodes were allocated one by one
+} bvh;
+
+/// object median split along the longest axis
 hittable* bvh_create(hittable** darray);
 
+/// binned surface area heuristic split, slower to build but usually much faster to trace
+hittable* bvh_create_sah(hittable** darray);
+
+/**
+ * @brief linear bvh builder for big scenes, the objects are sorted by the morton code of their centroid
+ * (30 bits, 63 bits past a million objects) with a radix sort and the tree is split on the code bits
+ * every step runs in parallel on the pool, pool = 0 builds on the calling thread
+ * much faster to build than the sah builder but the tree is usually a bit slower to trace
+ */
+hittable* bvh_create_lbvh(hittable** darray, zthread_pool* pool);
+
 void bvh_destroy(hittable* bvh);
 
+/// number of nodes, number of objects in the leaves and number of levels of the tree
+void bvh_count(hittable* bvh, u32* out_node_count, u32* out_object_count, u32* out_depth);
+
+/// expected cost of tracing a ray through the tree (surface area heuristic), lower is better
+f64 bvh_sah_cost(hittable* bvh);
+
 bool bvh_hit(hittable* bvh_object, ray* r_in, interval r_t, hit_record* record);
 
+/// any hit test, the first hit found ends the search
+bool bvh_occluded(hittable* bvh_object, ray* r_in, interval r_t);
+
+/**
+ * @brief copies a bvh (from either builder) into one contiguous array of 32 byte nodes in depth first order
+ * traversal is iterative with a fixed stack, near child first, and calls the objects only at the leaves
+ * the source bvh is not needed anymore after this and can be destroyed
+ */
+hittable* linear_bvh_create(hittable* bvh);
+
+void linear_bvh_destroy(hittable* linear);
+
+bool linear_bvh_hit(hittable* linear, ray* r_in, interval r_t, hit_record* record);
+
+bool linear_bvh_occluded(hittable* linear, ray* r_in, interval r_t);
+
 #endif
\ No newline at end of file
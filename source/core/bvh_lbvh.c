@@ -0,0 +1,386 @@
+#include "bvh.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zatomic.h"
+#include "darray.h"
+
+#define LBVH_MAX_LEAF_SIZE 4
+// objects per job of the parallel passes, smaller inputs run in fewer jobs
+#define LBVH_MIN_CHUNK_SIZE 4096
+#define LBVH_CHUNKS_PER_THREAD 4
+// subtrees with fewer objects than this are built by the job that reached them
+#define LBVH_MIN_TASK_SIZE 4096
+// 63 bit codes (21 bits per axis) past this many objects, 30 bit codes (10 bits per axis) below
+#define LBVH_WIDE_CODE_THRESHOLD (1u << 20)
+#define LBVH_RADIX_BITS 8
+#define LBVH_RADIX_SIZE (1 << LBVH_RADIX_BITS)
+
+typedef struct lbvh_key {
+    u64 code;
+    u32 index; // index of the object in the input darray
+} lbvh_key;
+
+typedef struct lbvh_build lbvh_build;
+
+typedef struct lbvh_chunk {
+    lbvh_build* build;
+    u32 start;
+    u32 end;
+    aabb centroid_box;
+    u32 histogram[LBVH_RADIX_SIZE]; // offsets of every digit after the prefix sum
+} lbvh_chunk;
+
+typedef struct lbvh_subtree {
+    lbvh_build* build;
+    bvh* node;
+    u32 first;
+    u32 last;
+} lbvh_subtree;
+
+struct lbvh_build {
+    zthread_pool* pool;
+    hittable** input;
+    lbvh_key* keys;
+    lbvh_key* keys_temp;
+    hittable** objects; // sorted by code, the leaves point into it
+    bvh* nodes;
+    volatile i32 next_node;
+    u32 object_count;
+    u32 bits_per_axis;
+    u32 shift; // digit of the current radix pass
+    f64 scale[3];
+    aabb centroid_box;
+    lbvh_chunk* chunks;
+    u32 chunk_count;
+};
+
+void lbvh_centroid_job(void* params);
+void lbvh_code_job(void* params);
+void lbvh_histogram_job(void* params);
+void lbvh_scatter_job(void* params);
+void lbvh_gather_job(void* params);
+void lbvh_subtree_job(void* params);
+void lbvh_sort(lbvh_build* build);
+void emit_lbvh(lbvh_build* build, bvh* node, u32 first, u32 last);
+u32 lbvh_find_split(const lbvh_key* keys, u32 first, u32 last);
+void lbvh_rotate(bvh* node);
+void lbvh_order_children(bvh* node);
+
+// spreads the low 21 bits of v so there are two zero bits between each of them
+INLINE u64 lbvh_expand_bits(u64 v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+hittable* bvh_create_lbvh(hittable** darray, zthread_pool* pool) {
+    if (darray == 0 || darray_length(darray) == 0 || darray_length(darray) > 0x3fffffff) {
+        LOGE("bvh_create_lbvh: invalid params");
+        return 0;
+    }
+
+    lbvh_build build = {0};
+    build.pool = pool;
+    build.input = darray;
+    build.object_count = darray_length(darray);
+    build.bits_per_axis = build.object_count > LBVH_WIDE_CODE_THRESHOLD ? 21 : 10;
+    build.keys = zmemory_allocate(build.object_count * sizeof(lbvh_key));
+    build.keys_temp = zmemory_allocate(build.object_count * sizeof(lbvh_key));
+    build.objects = zmemory_allocate(build.object_count * sizeof(hittable*));
+    // every inner node has two children and every leaf at least one object
+    u32 node_capacity = 2 * build.object_count - 1;
+    build.nodes = zmemory_allocate(node_capacity * sizeof(bvh));
+    build.next_node = 1;
+
+    u32 chunk_size = LBVH_MIN_CHUNK_SIZE;
+    if (pool) {
+        u32 max_chunks = zthread_pool_thread_count(pool) * LBVH_CHUNKS_PER_THREAD;
+        u32 even_size = (build.object_count + max_chunks - 1) / max_chunks;
+        chunk_size = even_size > chunk_size ? even_size : chunk_size;
+    }
+    build.chunk_count = (build.object_count + chunk_size - 1) / chunk_size;
+    build.chunks = zmemory_allocate(build.chunk_count * sizeof(lbvh_chunk));
+    for (u32 i = 0; i < build.chunk_count; ++i) {
+        build.chunks[i].build = &build;
+        build.chunks[i].start = i * chunk_size;
+        build.chunks[i].end = MIN(build.object_count, (i + 1) * chunk_size);
+    }
+
+    // the codes quantize the centroids inside their bounds
+    zthread_pool_parallel_for(build.pool, build.chunks, sizeof(lbvh_chunk), build.chunk_count, lbvh_centroid_job);
+    build.centroid_box = aabb_create_empty();
+    for (u32 i = 0; i < build.chunk_count; ++i) {
+        build.centroid_box = aabb_merge(build.chunks[i].centroid_box, build.centroid_box);
+    }
+    f64 cells = (f64)((1u << build.bits_per_axis) - 1);
+    for (i32 axis = 0; axis < 3; ++axis) {
+        f64 extent = interval_size(aabb_axis_interval(&build.centroid_box, axis));
+        build.scale[axis] = extent > 0.0 ? cells / extent : 0.0;
+    }
+    zthread_pool_parallel_for(build.pool, build.chunks, sizeof(lbvh_chunk), build.chunk_count, lbvh_code_job);
+    lbvh_sort(&build);
+    zthread_pool_parallel_for(build.pool, build.chunks, sizeof(lbvh_chunk), build.chunk_count, lbvh_gather_job);
+
+    bvh* root = build.nodes;
+    emit_lbvh(&build, root, 0, build.object_count - 1);
+
+    // give back the nodes the worst case estimate didn't need
+    u32 node_count = build.next_node;
+    bvh* nodes = zmemory_reallocate(build.nodes, node_count * sizeof(bvh), node_capacity * sizeof(bvh));
+    if (nodes != build.nodes) {
+        u64 delta = (u64)nodes - (u64)build.nodes;
+        for (u32 i = 0; i < node_count; ++i) {
+            if (nodes[i].object_count == 0) {
+                nodes[i].left = (hittable*)((u64)nodes[i].left + delta);
+                nodes[i].right = (hittable*)((u64)nodes[i].right + delta);
+            }
+        }
+        root = nodes;
+    }
+
+    root->block = zmemory_allocate(sizeof(bvh_block));
+    root->block->nodes = nodes;
+    root->block->node_count = node_count;
+    root->block->objects = build.objects;
+    root->block->object_count = build.object_count;
+
+    zmemory_free(build.chunks, build.chunk_count * sizeof(lbvh_chunk));
+    zmemory_free(build.keys, build.object_count * sizeof(lbvh_key));
+    zmemory_free(build.keys_temp, build.object_count * sizeof(lbvh_key));
+    return (hittable*)root;
+}
+
+//////////////////////////////////////////////////////////////////////
+//  __                  __                                          //
+// /  |                /  |                                         //
+// $$ |____    ______  $$ |  ______    ______    ______    _______  //
+// $$      \  /      \ $$ | /      \  /      \  /      \  /       | //
+// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  |/$$$$$$$/  //
+// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/ $$      \  //
+// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       $$$$$$  | //
+// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |      /     $$/  //
+// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/       $$$$$$$/   //
+//                         $$ |                                     //
+//                         $$ |                                     //
+//                         $$/                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+void lbvh_centroid_job(void* params) {
+    lbvh_chunk* chunk = params;
+    hittable** input = chunk->build->input;
+    aabb box = aabb_create_empty();
+    for (u32 i = chunk->start; i < chunk->end; ++i) {
+        point3 c = aabb_centroid(&input[i]->box);
+        box = aabb_merge((aabb){{c.x, c.x}, {c.y, c.y}, {c.z, c.z}}, box);
+    }
+    chunk->centroid_box = box;
+}
+
+void lbvh_code_job(void* params) {
+    lbvh_chunk* chunk = params;
+    lbvh_build* build = chunk->build;
+    const aabb* bounds = &build->centroid_box;
+    for (u32 i = chunk->start; i < chunk->end; ++i) {
+        point3 c = aabb_centroid(&build->input[i]->box);
+        u64 x = (u64)((c.x - bounds->x_range.min) * build->scale[0]);
+        u64 y = (u64)((c.y - bounds->y_range.min) * build->scale[1]);
+        u64 z = (u64)((c.z - bounds->z_range.min) * build->scale[2]);
+        build->keys[i] = (lbvh_key){lbvh_expand_bits(x) << 2 | lbvh_expand_bits(y) << 1 | lbvh_expand_bits(z), i};
+    }
+}
+
+void lbvh_histogram_job(void* params) {
+    lbvh_chunk* chunk = params;
+    lbvh_build* build = chunk->build;
+    zmemory_set_zero(chunk->histogram, sizeof(chunk->histogram));
+    for (u32 i = chunk->start; i < chunk->end; ++i) {
+        chunk->histogram[(build->keys[i].code >> build->shift) & (LBVH_RADIX_SIZE - 1)]++;
+    }
+}
+
+void lbvh_scatter_job(void* params) {
+    lbvh_chunk* chunk = params;
+    lbvh_build* build = chunk->build;
+    for (u32 i = chunk->start; i < chunk->end; ++i) {
+        lbvh_key key = build->keys[i];
+        build->keys_temp[chunk->histogram[(key.code >> build->shift) & (LBVH_RADIX_SIZE - 1)]++] = key;
+    }
+}
+
+void lbvh_gather_job(void* params) {
+    lbvh_chunk* chunk = params;
+    lbvh_build* build = chunk->build;
+    for (u32 i = chunk->start; i < chunk->end; ++i) {
+        build->objects[i] = build->input[build->keys[i].index];
+    }
+}
+
+void lbvh_subtree_job(void* params) {
+    lbvh_subtree* subtree = params;
+    emit_lbvh(subtree->build, subtree->node, subtree->first, subtree->last);
+}
+
+void lbvh_sort(lbvh_build* build) {
+    // least significant digit first, every pass is stable so the earlier digits stay sorted
+    u32 code_bits = 3 * build->bits_per_axis;
+    for (build->shift = 0; build->shift < code_bits; build->shift += LBVH_RADIX_BITS) {
+        zthread_pool_parallel_for(build->pool, build->chunks, sizeof(lbvh_chunk), build->chunk_count, lbvh_histogram_job);
+
+        // a digit all the keys share doesn't change the order, the sparse high digits often do that
+        bool single_digit = false;
+        for (u32 digit = 0; digit < LBVH_RADIX_SIZE && !single_digit; ++digit) {
+            u32 total = 0;
+            for (u32 i = 0; i < build->chunk_count; ++i) {
+                total += build->chunks[i].histogram[digit];
+            }
+            single_digit = total == build->object_count;
+        }
+        if (single_digit) {
+            continue;
+        }
+
+        // turn the counts into the first output index of every digit of every chunk
+        u32 offset = 0;
+        for (u32 digit = 0; digit < LBVH_RADIX_SIZE; ++digit) {
+            for (u32 i = 0; i < build->chunk_count; ++i) {
+                u32 count = build->chunks[i].histogram[digit];
+                build->chunks[i].histogram[digit] = offset;
+                offset += count;
+            }
+        }
+        zthread_pool_parallel_for(build->pool, build->chunks, sizeof(lbvh_chunk), build->chunk_count, lbvh_scatter_job);
+
+        lbvh_key* swap = build->keys;
+        build->keys = build->keys_temp;
+        build->keys_temp = swap;
+    }
+}
+
+void emit_lbvh(lbvh_build* build, bvh* node, u32 first, u32 last) {
+    node->base.hit = bvh_hit;
+    node->base.occluded = bvh_occluded;
+    u32 count = last - first + 1;
+    if (count <= LBVH_MAX_LEAF_SIZE) {
+        node->objects = build->objects + first;
+        node->object_count = count;
+        aabb box = aabb_create_empty();
+        for (u32 i = first; i <= last; ++i) {
+            box = aabb_merge(build->objects[i]->box, box);
+        }
+        node->base.box = box;
+        return;
+    }
+
+    u32 split = lbvh_find_split(build->keys, first, last);
+    bvh* left = build->nodes + zatomic_fetch_add_i32(&build->next_node, 2);
+    bvh* right = left + 1;
+    node->left = (hittable*)left;
+    node->right = (hittable*)right;
+
+    // big subtrees go to the pool, waiting on them runs other queued jobs so nesting is fine
+    zthread_wait_group group;
+    if (build->pool && split - first + 1 >= LBVH_MIN_TASK_SIZE && zthread_wait_group_create(&group)) {
+        lbvh_subtree subtree = {build, left, first, split};
+        if (!zthread_pool_submit(build->pool, lbvh_subtree_job, &subtree, &group)) {
+            lbvh_subtree_job(&subtree);
+        }
+        emit_lbvh(build, right, split + 1, last);
+        zthread_pool_wait(build->pool, &group);
+        zthread_wait_group_destroy(&group);
+    } else {
+        emit_lbvh(build, left, first, split);
+        emit_lbvh(build, right, split + 1, last);
+    }
+
+    node->base.box = aabb_merge(left->base.box, right->base.box);
+    u64 diff = build->keys[first].code ^ build->keys[last].code;
+    if (diff != 0) {
+        // x, y and z bits are interleaved from the top, so the first differing bit tells the split axis
+        node->axis = 2 - (63 - __builtin_clzll(diff)) % 3;
+    } else {
+        node->axis = aabb_longest_axis(&node->base.box);
+    }
+    lbvh_rotate(node);
+}
+
+// the morton splits ignore the object sizes, a big object ends up deep in the tree inside a big box
+// swapping a child with a grandchild (a tree rotation) changes only the bounds of the other child,
+// so every swap that shrinks them lowers the sah cost, the children are final when this runs so one pass bottom up is enough
+void lbvh_rotate(bvh* node) {
+    hittable** best_child = 0;
+    hittable** best_grandchild = 0;
+    bvh* best_other = 0;
+    f64 best_area = 0.0;
+    for (i32 side = 0; side < 2; ++side) {
+        hittable** child = side ? &node->right : &node->left;
+        bvh* other = (bvh*)(side ? node->left : node->right);
+        if (other->object_count != 0) {
+            continue;
+        }
+        f64 area = aabb_surface_area(&other->base.box);
+        for (i32 g = 0; g < 2; ++g) {
+            hittable** grandchild = g ? &other->right : &other->left;
+            hittable* kept = g ? other->left : other->right;
+            aabb merged = aabb_merge((*child)->box, kept->box);
+            f64 saved = area - aabb_surface_area(&merged);
+            if (saved > best_area) {
+                best_area = saved;
+                best_child = child;
+                best_grandchild = grandchild;
+                best_other = other;
+            }
+        }
+    }
+    if (best_other == 0) {
+        return;
+    }
+    hittable* swap = *best_child;
+    *best_child = *best_grandchild;
+    *best_grandchild = swap;
+    best_other->base.box = aabb_merge(best_other->left->box, best_other->right->box);
+    lbvh_order_children(best_other);
+    lbvh_order_children(node);
+}
+
+// the traversal visits the left child first when the ray goes up the split axis, keep that true after a rotation
+void lbvh_order_children(bvh* node) {
+    point3 left = aabb_centroid(&node->left->box);
+    point3 right = aabb_centroid(&node->right->box);
+    vec3 delta = vec3_sub(right, left);
+    f64 dx = zfabs(delta.x);
+    f64 dy = zfabs(delta.y);
+    f64 dz = zfabs(delta.z);
+    node->axis = dx >= dy && dx >= dz ? 0 : (dy >= dz ? 1 : 2);
+    if (vec3_axis(delta, node->axis) < 0.0) {
+        hittable* swap = node->left;
+        node->left = node->right;
+        node->right = swap;
+    }
+}
+
+// returns the last index of the left child: the last key that still shares the first differing bit with keys[first]
+u32 lbvh_find_split(const lbvh_key* keys, u32 first, u32 last) {
+    u64 first_code = keys[first].code;
+    u64 last_code = keys[last].code;
+    if (first_code == last_code) {
+        return (first + last) / 2; // same cell, split by count
+    }
+    i32 common_prefix = __builtin_clzll(first_code ^ last_code);
+
+    // binary search for the highest key with a longer common prefix than the whole range
+    u32 split = first;
+    u32 step = last - first;
+    do {
+        step = (step + 1) / 2;
+        u32 candidate = split + step;
+        if (candidate < last && __builtin_clzll(first_code ^ keys[candidate].code) > common_prefix) {
+            split = candidate;
+        }
+    } while (step > 1);
+    return split;
+}
@@ -0,0 +1,744 @@
+#include "bvh_wide.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "platform.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define BVH_WIDE_X86
+#    include <immintrin.h>
+#    define TARGET_SSE __attribute__((target("sse2")))
+#    define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+#define BVH_WIDE_MAX_WIDTH 8
+#define BVH_WIDE_STACK_SIZE 256
+#define BVH_WIDE_PACKET_SIZE 4
+// the box test runs in float, the far distance is scaled up a bit so rounding never culls a box the ray touches
+#define BVH_WIDE_FAR_SCALE (1.0f + 4.0f * FLT_EPSILON)
+// and the node bounds are padded by this fraction of the scene size to cover the rounding of the ray origin
+#define BVH_WIDE_BOUNDS_PAD (1.0 / (1 << 20))
+
+/**
+ * node layout for width W (32 * W bytes):
+ * f32 min_x[W], min_y[W], min_z[W], max_x[W], max_y[W], max_z[W]
+ * u32 child[W] -> inner child: node index, leaf child: leaf index
+ * u32 leaf[W] -> 1 for leaf children, 0 for inner children
+ * unused children have empty bounds (+inf, -inf) which no ray can hit
+ */
+typedef struct bvh_wide_leaf {
+    u32 first_packet;
+    u32 packet_count;
+    u32 first_object;
+    u32 object_count;
+} bvh_wide_leaf;
+
+/**
+ * quads, triangles and circles of a leaf are grouped in packets of 4 in SoA form and tested in one pass
+ * all of them are a plane hit followed by a test on the plane coordinates alpha = dot(dp, A), beta = dot(dp, B)
+ * of dp = point - Q, only the limits differ:
+ * quad: A = cross(v, W), B = cross(W, u) and 0 <= alpha, beta <= 1
+ * triangle: same as the quad and alpha + beta <= 1
+ * circle: A = bitangent / radius, B = tangent / radius and alpha^2 + beta^2 <= 1
+ * unused lanes have a zero normal, which is rejected like a ray parallel to the plane
+ */
+typedef struct bvh_wide_packet {
+    f64 normal[3][BVH_WIDE_PACKET_SIZE];
+    f64 D[BVH_WIDE_PACKET_SIZE];
+    f64 Q[3][BVH_WIDE_PACKET_SIZE];
+    f64 A[3][BVH_WIDE_PACKET_SIZE];
+    f64 B[3][BVH_WIDE_PACKET_SIZE];
+    f64 lower[BVH_WIDE_PACKET_SIZE];        /// lowest alpha and beta, -1 for circles
+    f64 sum_limit[BVH_WIDE_PACKET_SIZE];    /// highest alpha + beta, 1 for triangles
+    f64 radius_limit[BVH_WIDE_PACKET_SIZE]; /// highest alpha^2 + beta^2, 1 for circles
+    hittable* objects[BVH_WIDE_PACKET_SIZE]; /// the primitives, their surface is computed by hittable_surface
+} bvh_wide_packet;
+
+typedef struct bvh_wide {
+    hittable base;
+    u8* nodes;
+    bvh_wide_leaf* leaves;
+    bvh_wide_packet* packets;
+    hittable** objects; /// everything that doesn't fit in a packet
+    u32 width;
+    u32 node_size;
+    u32 node_count;
+    u32 node_capacity;
+    u32 leaf_count;
+    u32 leaf_capacity;
+    u32 packet_count;
+    u32 packet_capacity;
+    u32 object_count;
+    u32 object_capacity;
+    f64 pad;
+} bvh_wide;
+
+typedef struct bvh_wide_ray {
+    f32 origin[3];
+    f32 inv_direction[3];
+    const i32* sign;
+    f32 t_min;
+    f32 t_max;
+} bvh_wide_ray;
+
+typedef struct bvh_wide_entry {
+    u32 child;
+    u32 leaf; // 0 for nodes
+    f32 t_near;
+} bvh_wide_entry;
+
+/// returns the mask of the children the ray hits and writes their entry distances
+typedef u32 (*PFN_bvh_wide_kernel)(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near);
+/// returns the mask of the packet lanes the ray hits inside r_t and writes their t, alpha and beta
+typedef u32 (*PFN_bvh_wide_packet_kernel)(const bvh_wide_packet* packet, const ray* r, interval r_t,
+                                          f64* out_t, f64* out_alpha, f64* out_beta);
+
+void* bvh_wide_shrink(void* block, u64 new_size, u64 old_size);
+u32 collapse_bvh(bvh_wide* wide, bvh* node, u32 depth, u32* out_depth);
+bool bvh_wide_is_planar(hittable* object);
+bool bvh_wide_gather_planar(bvh* node, hittable** out_objects, u32* count, u32 limit);
+u32 bvh_wide_add_leaf(bvh_wide* wide, hittable** objects, u32 object_count);
+void bvh_wide_packet_set(bvh_wide_packet* packet, u32 lane, hittable* object);
+void bvh_wide_packet_record(const bvh_wide_packet* packet, u32 lane, f64 t, f64 alpha, f64 beta, hit_record* record);
+u32 bvh_wide_kernel_scalar(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near);
+u32 bvh_wide_packet_kernel_scalar(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta);
+bool bvh_wide_hit_scalar(hittable* object, ray* r_in, interval r_t, hit_record* record);
+bool bvh_wide_occluded_scalar(hittable* object, ray* r_in, interval r_t);
+#ifdef BVH_WIDE_X86
+TARGET_SSE u32 bvh_wide_kernel_sse(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near);
+TARGET_AVX2 u32 bvh_wide_kernel_avx2(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near);
+TARGET_SSE u32 bvh_wide_packet_kernel_sse(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta);
+TARGET_AVX2 u32 bvh_wide_packet_kernel_avx2(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta);
+TARGET_SSE bool bvh_wide_hit_sse(hittable* object, ray* r_in, interval r_t, hit_record* record);
+TARGET_AVX2 bool bvh_wide_hit_avx2(hittable* object, ray* r_in, interval r_t, hit_record* record);
+TARGET_AVX2 bool bvh_wide_hit_sse_avx2(hittable* object, ray* r_in, interval r_t, hit_record* record);
+TARGET_SSE bool bvh_wide_occluded_sse(hittable* object, ray* r_in, interval r_t);
+TARGET_AVX2 bool bvh_wide_occluded_avx2(hittable* object, ray* r_in, interval r_t);
+TARGET_AVX2 bool bvh_wide_occluded_sse_avx2(hittable* object, ray* r_in, interval r_t);
+#endif
+
+hittable* bvh_wide_create(hittable* tree, u32 width) {
+    if (tree == 0 || tree->hit != bvh_hit || (width != 0 && width != 4 && width != 8)) {
+        LOGE("bvh_wide_create: invalid params");
+        return 0;
+    }
+
+    bool has_avx2 = platform_cpu_supports_avx2();
+    if (width == 0) {
+        width = has_avx2 ? 8 : 4;
+    }
+
+    bvh* root = (bvh*)tree;
+    u32 node_count = 0;
+    u32 object_count = 0;
+    u32 max_depth = 0;
+    bvh_count(tree, &node_count, &object_count, &max_depth);
+
+    bvh_wide* wide = zmemory_allocate(sizeof(bvh_wide));
+    wide->base.box = tree->box;
+    wide->width = width;
+    wide->node_size = width * 8 * sizeof(f32);
+    // every wide node takes at least one binary node, the array is shrunk once the tree is collapsed
+    wide->node_capacity = node_count;
+    wide->nodes = zmemory_allocate((u64)wide->node_capacity * wide->node_size);
+    // same for the leaves, the packets grow as they are filled since most scenes have few planar objects
+    wide->leaf_capacity = node_count;
+    wide->leaves = zmemory_allocate(wide->leaf_capacity * sizeof(bvh_wide_leaf));
+    wide->object_capacity = object_count;
+    wide->objects = zmemory_allocate(wide->object_capacity * sizeof(hittable*));
+
+    // size of the scene, for the padding of the float bounds
+    f64 scale = 0.0;
+    f64 extents[6] = {tree->box.x_range.min, tree->box.y_range.min, tree->box.z_range.min,
+                      tree->box.x_range.max, tree->box.y_range.max, tree->box.z_range.max};
+    for (i32 i = 0; i < 6; ++i) {
+        f64 extent = zfabs(extents[i]);
+        if (extent < INFINITY && extent > scale) {
+            scale = extent;
+        }
+    }
+    wide->pad = scale * BVH_WIDE_BOUNDS_PAD;
+
+    u32 depth = 0;
+    collapse_bvh(wide, root, 1, &depth);
+    wide->nodes = zmemory_reallocate(wide->nodes, (u64)wide->node_count * wide->node_size,
+                                     (u64)wide->node_capacity * wide->node_size);
+    wide->node_capacity = wide->node_count;
+    wide->leaves = bvh_wide_shrink(wide->leaves, wide->leaf_count * sizeof(bvh_wide_leaf),
+                                   wide->leaf_capacity * sizeof(bvh_wide_leaf));
+    wide->leaf_capacity = wide->leaf_count;
+    wide->packets = bvh_wide_shrink(wide->packets, wide->packet_count * sizeof(bvh_wide_packet),
+                                    wide->packet_capacity * sizeof(bvh_wide_packet));
+    wide->packet_capacity = wide->packet_count;
+    wide->objects = bvh_wide_shrink(wide->objects, wide->object_count * sizeof(hittable*),
+                                    wide->object_capacity * sizeof(hittable*));
+    wide->object_capacity = wide->object_count;
+    // every level can leave (width - 1) children on the stack
+    if (depth * (width - 1) + 1 > BVH_WIDE_STACK_SIZE) {
+        LOGE("bvh_wide_create: bvh is too deep (%u levels)", depth);
+        bvh_wide_destroy((hittable*)wide);
+        return 0;
+    }
+
+    wide->base.hit = bvh_wide_hit_scalar;
+    wide->base.occluded = bvh_wide_occluded_scalar;
+#ifdef BVH_WIDE_X86
+    wide->base.hit = !has_avx2 ? bvh_wide_hit_sse : width == 8 ? bvh_wide_hit_avx2 : bvh_wide_hit_sse_avx2;
+    wide->base.occluded = !has_avx2 ? bvh_wide_occluded_sse : width == 8 ? bvh_wide_occluded_avx2 : bvh_wide_occluded_sse_avx2;
+#endif
+    return (hittable*)wide;
+}
+
+void bvh_wide_destroy(hittable* object) {
+    if (object == 0) {
+        LOGE("bvh_wide_destroy: invalid params");
+        return;
+    }
+    bvh_wide* wide = (bvh_wide*)object;
+    zmemory_free(wide->nodes, (u64)wide->node_capacity * wide->node_size);
+    zmemory_free(wide->leaves, wide->leaf_capacity * sizeof(bvh_wide_leaf));
+    if (wide->packets != 0) {
+        zmemory_free(wide->packets, wide->packet_capacity * sizeof(bvh_wide_packet));
+    }
+    if (wide->objects != 0) {
+        zmemory_free(wide->objects, wide->object_capacity * sizeof(hittable*));
+    }
+    zmemory_free(wide, sizeof(bvh_wide));
+}
+
+//////////////////////////////////////////////////////////////////////
+//  __                  __                                          //
+// /  |                /  |                                         //
+// $$ |____    ______  $$ |  ______    ______    ______    _______  //
+// $$      \  /      \ $$ | /      \  /      \  /      \  /       | //
+// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  |/$$$$$$$/  //
+// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/ $$      \  //
+// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       $$$$$$  | //
+// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |      /     $$/  //
+// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/       $$$$$$$/   //
+//                         $$ |                                     //
+//                         $$ |                                     //
+//                         $$/                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+void* bvh_wide_shrink(void* block, u64 new_size, u64 old_size) {
+    if (block == 0 || new_size == old_size) {
+        return block;
+    }
+    if (new_size == 0) {
+        zmemory_free(block, old_size);
+        return 0;
+    }
+    return zmemory_reallocate(block, new_size, old_size);
+}
+
+u32 collapse_bvh(bvh_wide* wide, bvh* node, u32 depth, u32* out_depth) {
+    u32 index = wide->node_count++;
+    *out_depth = depth > *out_depth ? depth : *out_depth;
+
+    // open the biggest inner child until the node is full, a subtree of a few planar objects is kept whole
+    // since it fits in the packets of one leaf
+    hittable* planar[BVH_WIDE_MAX_WIDTH];
+    u32 planar_count = 0;
+    bvh* children[BVH_WIDE_MAX_WIDTH];
+    u32 child_count = 0;
+    if (node->object_count != 0) {
+        children[child_count++] = node; // the root is a leaf
+    } else {
+        children[child_count++] = (bvh*)node->left;
+        children[child_count++] = (bvh*)node->right;
+    }
+    while (child_count < wide->width) {
+        i32 best = -1;
+        f64 best_area = -1.0;
+        for (u32 i = 0; i < child_count; ++i) {
+            f64 area = aabb_surface_area(&children[i]->base.box);
+            planar_count = 0;
+            if (children[i]->object_count == 0 && area > best_area &&
+                !bvh_wide_gather_planar(children[i], planar, &planar_count, wide->width)) {
+                best_area = area;
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        bvh* opened = children[best];
+        children[best] = (bvh*)opened->left;
+        children[child_count++] = (bvh*)opened->right;
+    }
+
+    u32 width = wide->width;
+    f32* bounds = (f32*)(wide->nodes + (u64)index * wide->node_size);
+    u32* child = (u32*)(bounds + 6 * width);
+    u32* leaf = child + width;
+    for (u32 i = 0; i < width; ++i) {
+        if (i >= child_count) {
+            bounds[0 * width + i] = bounds[1 * width + i] = bounds[2 * width + i] = INFINITY;
+            bounds[3 * width + i] = bounds[4 * width + i] = bounds[5 * width + i] = -INFINITY;
+            continue;
+        }
+        aabb* box = &children[i]->base.box;
+        bounds[0 * width + i] = zfloat_round_down(box->x_range.min - wide->pad);
+        bounds[1 * width + i] = zfloat_round_down(box->y_range.min - wide->pad);
+        bounds[2 * width + i] = zfloat_round_down(box->z_range.min - wide->pad);
+        bounds[3 * width + i] = zfloat_round_up(box->x_range.max + wide->pad);
+        bounds[4 * width + i] = zfloat_round_up(box->y_range.max + wide->pad);
+        bounds[5 * width + i] = zfloat_round_up(box->z_range.max + wide->pad);
+        planar_count = 0;
+        if (children[i]->object_count != 0) {
+            child[i] = bvh_wide_add_leaf(wide, children[i]->objects, children[i]->object_count);
+            leaf[i] = 1;
+        } else if (bvh_wide_gather_planar(children[i], planar, &planar_count, width)) {
+            child[i] = bvh_wide_add_leaf(wide, planar, planar_count);
+            leaf[i] = 1;
+        } else {
+            child[i] = collapse_bvh(wide, children[i], depth + 1, out_depth);
+            leaf[i] = 0;
+        }
+    }
+    return index;
+}
+
+bool bvh_wide_is_planar(hittable* object) {
+    return object->hit == quad_hit || object->hit == triangle_hit || object->hit == circle_hit;
+}
+
+/// collects the objects of a subtree, false if one of them is not planar or there are more than limit
+bool bvh_wide_gather_planar(bvh* node, hittable** out_objects, u32* count, u32 limit) {
+    if (node->object_count == 0) {
+        return bvh_wide_gather_planar((bvh*)node->left, out_objects, count, limit) &&
+               bvh_wide_gather_planar((bvh*)node->right, out_objects, count, limit);
+    }
+    for (u32 i = 0; i < node->object_count; ++i) {
+        if (*count == limit || !bvh_wide_is_planar(node->objects[i])) {
+            return false;
+        }
+        out_objects[(*count)++] = node->objects[i];
+    }
+    return true;
+}
+
+u32 bvh_wide_add_leaf(bvh_wide* wide, hittable** objects, u32 object_count) {
+    u32 index = wide->leaf_count++;
+    bvh_wide_leaf* leaf = wide->leaves + index;
+    leaf->first_packet = wide->packet_count;
+    leaf->first_object = wide->object_count;
+
+    u32 lane = BVH_WIDE_PACKET_SIZE;
+    for (u32 i = 0; i < object_count; ++i) {
+        if (!bvh_wide_is_planar(objects[i])) {
+            wide->objects[wide->object_count++] = objects[i];
+            leaf->object_count++;
+            continue;
+        }
+        if (lane == BVH_WIDE_PACKET_SIZE) {
+            if (wide->packet_count == wide->packet_capacity) {
+                u32 capacity = wide->packet_capacity == 0 ? 64 : 2 * wide->packet_capacity;
+                if (wide->packets == 0) {
+                    wide->packets = zmemory_allocate(capacity * sizeof(bvh_wide_packet));
+                } else {
+                    wide->packets = zmemory_reallocate(wide->packets, capacity * sizeof(bvh_wide_packet),
+                                                       wide->packet_capacity * sizeof(bvh_wide_packet));
+                    // the unused lanes must keep a zero normal
+                    zmemory_set_zero(wide->packets + wide->packet_capacity,
+                                     (capacity - wide->packet_capacity) * sizeof(bvh_wide_packet));
+                }
+                wide->packet_capacity = capacity;
+            }
+            wide->packet_count++;
+            leaf->packet_count++;
+            lane = 0;
+        }
+        bvh_wide_packet_set(wide->packets + wide->packet_count - 1, lane++, objects[i]);
+    }
+    return index;
+}
+
+void bvh_wide_packet_set(bvh_wide_packet* packet, u32 lane, hittable* object) {
+    vec3 normal, Q, A, B;
+    f64 D;
+    if (object->hit == circle_hit) {
+        circle* cir = (circle*)object;
+        normal = cir->normal;
+        D = cir->D;
+        Q = cir->center;
+        A = vec3_mul_scalar(1.0 / cir->radius, cir->bitangent);
+        B = vec3_mul_scalar(1.0 / cir->radius, cir->tangent);
+        packet->lower[lane] = -1.0;
+        packet->sum_limit[lane] = 2.0;
+        packet->radius_limit[lane] = 1.0;
+    } else {
+        // quad and triangle have the same layout, alpha = dot(W, cross(dp, v)) = dot(dp, cross(v, W))
+        // and beta = dot(W, cross(u, dp)) = dot(dp, cross(W, u))
+        bool is_triangle = object->hit == triangle_hit;
+        quad* qu = (quad*)object;
+        normal = qu->normal;
+        D = qu->D;
+        Q = qu->Q;
+        A = vec3_cross(qu->v, qu->W);
+        B = vec3_cross(qu->W, qu->u);
+        packet->lower[lane] = 0.0;
+        packet->sum_limit[lane] = is_triangle ? 1.0 : 2.0;
+        packet->radius_limit[lane] = 2.0;
+    }
+    packet->objects[lane] = object;
+    packet->normal[0][lane] = normal.x;
+    packet->normal[1][lane] = normal.y;
+    packet->normal[2][lane] = normal.z;
+    packet->D[lane] = D;
+    packet->Q[0][lane] = Q.x;
+    packet->Q[1][lane] = Q.y;
+    packet->Q[2][lane] = Q.z;
+    packet->A[0][lane] = A.x;
+    packet->A[1][lane] = A.y;
+    packet->A[2][lane] = A.z;
+    packet->B[0][lane] = B.x;
+    packet->B[1][lane] = B.y;
+    packet->B[2][lane] = B.z;
+}
+
+void bvh_wide_packet_record(const bvh_wide_packet* packet, u32 lane, f64 t, f64 alpha, f64 beta, hit_record* record) {
+    // the same record the object's own hit writes, so its surface function finishes it
+    hit_record_set_hit(record, packet->objects[lane], t);
+    record->b1 = alpha;
+    record->b2 = beta;
+}
+
+u32 bvh_wide_kernel_scalar(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near) {
+    const f32* near_x = node + (r->sign[0] ? 3 : 0) * width;
+    const f32* near_y = node + (r->sign[1] ? 4 : 1) * width;
+    const f32* near_z = node + (r->sign[2] ? 5 : 2) * width;
+    const f32* far_x = node + (r->sign[0] ? 0 : 3) * width;
+    const f32* far_y = node + (r->sign[1] ? 1 : 4) * width;
+    const f32* far_z = node + (r->sign[2] ? 2 : 5) * width;
+
+    u32 mask = 0;
+    for (u32 i = 0; i < width; ++i) {
+        f32 tx_near = (near_x[i] - r->origin[0]) * r->inv_direction[0];
+        f32 ty_near = (near_y[i] - r->origin[1]) * r->inv_direction[1];
+        f32 tz_near = (near_z[i] - r->origin[2]) * r->inv_direction[2];
+        f32 tx_far = (far_x[i] - r->origin[0]) * r->inv_direction[0];
+        f32 ty_far = (far_y[i] - r->origin[1]) * r->inv_direction[1];
+        f32 tz_far = (far_z[i] - r->origin[2]) * r->inv_direction[2];
+        f32 t_near = MAX(tx_near, MAX(ty_near, MAX(tz_near, r->t_min)));
+        f32 t_far = MIN(tx_far, MIN(ty_far, MIN(tz_far, r->t_max))) * BVH_WIDE_FAR_SCALE;
+        out_t_near[i] = t_near;
+        mask |= (u32)(t_near <= t_far) << i;
+    }
+    return mask;
+}
+
+u32 bvh_wide_packet_kernel_scalar(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta) {
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDE_PACKET_SIZE; ++i) {
+        f64 deno = packet->normal[0][i] * r->direction.x + packet->normal[1][i] * r->direction.y +
+                   packet->normal[2][i] * r->direction.z;
+        f64 t = (packet->D[i] - (packet->normal[0][i] * r->origin.x + packet->normal[1][i] * r->origin.y +
+                                 packet->normal[2][i] * r->origin.z)) / deno;
+        f64 dp_x = r->origin.x + r->direction.x * t - packet->Q[0][i];
+        f64 dp_y = r->origin.y + r->direction.y * t - packet->Q[1][i];
+        f64 dp_z = r->origin.z + r->direction.z * t - packet->Q[2][i];
+        f64 alpha = dp_x * packet->A[0][i] + dp_y * packet->A[1][i] + dp_z * packet->A[2][i];
+        f64 beta = dp_x * packet->B[0][i] + dp_y * packet->B[1][i] + dp_z * packet->B[2][i];
+        bool inside = zfabs(deno) >= DBL_EPSILON && t > r_t.min && t < r_t.max &&
+                      alpha >= packet->lower[i] && alpha <= 1.0 && beta >= packet->lower[i] && beta <= 1.0 &&
+                      alpha + beta <= packet->sum_limit[i] && alpha * alpha + beta * beta <= packet->radius_limit[i];
+        out_t[i] = t;
+        out_alpha[i] = alpha;
+        out_beta[i] = beta;
+        mask |= (u32)inside << i;
+    }
+    return mask;
+}
+
+#ifdef BVH_WIDE_X86
+
+TARGET_SSE u32 bvh_wide_kernel_sse(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near) {
+    const f32* near_x = node + (r->sign[0] ? 3 : 0) * width;
+    const f32* near_y = node + (r->sign[1] ? 4 : 1) * width;
+    const f32* near_z = node + (r->sign[2] ? 5 : 2) * width;
+    const f32* far_x = node + (r->sign[0] ? 0 : 3) * width;
+    const f32* far_y = node + (r->sign[1] ? 1 : 4) * width;
+    const f32* far_z = node + (r->sign[2] ? 2 : 5) * width;
+    __m128 origin_x = _mm_set1_ps(r->origin[0]);
+    __m128 origin_y = _mm_set1_ps(r->origin[1]);
+    __m128 origin_z = _mm_set1_ps(r->origin[2]);
+    __m128 inv_x = _mm_set1_ps(r->inv_direction[0]);
+    __m128 inv_y = _mm_set1_ps(r->inv_direction[1]);
+    __m128 inv_z = _mm_set1_ps(r->inv_direction[2]);
+    __m128 t_min = _mm_set1_ps(r->t_min);
+    __m128 t_max = _mm_set1_ps(r->t_max);
+    __m128 far_scale = _mm_set1_ps(BVH_WIDE_FAR_SCALE);
+
+    u32 mask = 0;
+    for (u32 i = 0; i < width; i += 4) {
+        __m128 tx_near = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_x + i), origin_x), inv_x);
+        __m128 ty_near = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_y + i), origin_y), inv_y);
+        __m128 tz_near = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_z + i), origin_z), inv_z);
+        __m128 tx_far = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_x + i), origin_x), inv_x);
+        __m128 ty_far = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_y + i), origin_y), inv_y);
+        __m128 tz_far = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_z + i), origin_z), inv_z);
+        // min/max return the second operand for NaN (origin on a slab plane), so the ray range always wins
+        __m128 t_near = _mm_max_ps(tx_near, _mm_max_ps(ty_near, _mm_max_ps(tz_near, t_min)));
+        __m128 t_far = _mm_min_ps(tx_far, _mm_min_ps(ty_far, _mm_min_ps(tz_far, t_max)));
+        t_far = _mm_mul_ps(t_far, far_scale);
+        _mm_storeu_ps(out_t_near + i, t_near);
+        mask |= (u32)_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)) << i;
+    }
+    return mask;
+}
+
+TARGET_AVX2 u32 bvh_wide_kernel_avx2(const f32* node, u32 width, const bvh_wide_ray* r, f32* out_t_near) {
+    // 8 wide nodes only, t = bound * inv - origin * inv, one fma per plane
+    const f32* near_x = node + (r->sign[0] ? 3 : 0) * width;
+    const f32* near_y = node + (r->sign[1] ? 4 : 1) * width;
+    const f32* near_z = node + (r->sign[2] ? 5 : 2) * width;
+    const f32* far_x = node + (r->sign[0] ? 0 : 3) * width;
+    const f32* far_y = node + (r->sign[1] ? 1 : 4) * width;
+    const f32* far_z = node + (r->sign[2] ? 2 : 5) * width;
+    __m256 inv_x = _mm256_set1_ps(r->inv_direction[0]);
+    __m256 inv_y = _mm256_set1_ps(r->inv_direction[1]);
+    __m256 inv_z = _mm256_set1_ps(r->inv_direction[2]);
+    __m256 origin_inv_x = _mm256_set1_ps(r->origin[0] * r->inv_direction[0]);
+    __m256 origin_inv_y = _mm256_set1_ps(r->origin[1] * r->inv_direction[1]);
+    __m256 origin_inv_z = _mm256_set1_ps(r->origin[2] * r->inv_direction[2]);
+
+    __m256 tx_near = _mm256_fmsub_ps(_mm256_loadu_ps(near_x), inv_x, origin_inv_x);
+    __m256 ty_near = _mm256_fmsub_ps(_mm256_loadu_ps(near_y), inv_y, origin_inv_y);
+    __m256 tz_near = _mm256_fmsub_ps(_mm256_loadu_ps(near_z), inv_z, origin_inv_z);
+    __m256 tx_far = _mm256_fmsub_ps(_mm256_loadu_ps(far_x), inv_x, origin_inv_x);
+    __m256 ty_far = _mm256_fmsub_ps(_mm256_loadu_ps(far_y), inv_y, origin_inv_y);
+    __m256 tz_far = _mm256_fmsub_ps(_mm256_loadu_ps(far_z), inv_z, origin_inv_z);
+    __m256 t_near = _mm256_max_ps(tx_near, _mm256_max_ps(ty_near, _mm256_max_ps(tz_near, _mm256_set1_ps(r->t_min))));
+    __m256 t_far = _mm256_min_ps(tx_far, _mm256_min_ps(ty_far, _mm256_min_ps(tz_far, _mm256_set1_ps(r->t_max))));
+    t_far = _mm256_mul_ps(t_far, _mm256_set1_ps(BVH_WIDE_FAR_SCALE));
+    _mm256_storeu_ps(out_t_near, t_near);
+    return (u32)_mm256_movemask_ps(_mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ));
+}
+
+TARGET_SSE u32 bvh_wide_packet_kernel_sse(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta) {
+    // 2 lanes per pass
+    __m128d origin_x = _mm_set1_pd(r->origin.x);
+    __m128d origin_y = _mm_set1_pd(r->origin.y);
+    __m128d origin_z = _mm_set1_pd(r->origin.z);
+    __m128d direction_x = _mm_set1_pd(r->direction.x);
+    __m128d direction_y = _mm_set1_pd(r->direction.y);
+    __m128d direction_z = _mm_set1_pd(r->direction.z);
+    __m128d t_min = _mm_set1_pd(r_t.min);
+    __m128d t_max = _mm_set1_pd(r_t.max);
+    __m128d epsilon = _mm_set1_pd(DBL_EPSILON);
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d sign_bit = _mm_set1_pd(-0.0);
+
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDE_PACKET_SIZE; i += 2) {
+        __m128d normal_x = _mm_loadu_pd(packet->normal[0] + i);
+        __m128d normal_y = _mm_loadu_pd(packet->normal[1] + i);
+        __m128d normal_z = _mm_loadu_pd(packet->normal[2] + i);
+        __m128d deno = _mm_add_pd(_mm_add_pd(_mm_mul_pd(normal_x, direction_x), _mm_mul_pd(normal_y, direction_y)),
+                                  _mm_mul_pd(normal_z, direction_z));
+        __m128d distance = _mm_add_pd(_mm_add_pd(_mm_mul_pd(normal_x, origin_x), _mm_mul_pd(normal_y, origin_y)),
+                                      _mm_mul_pd(normal_z, origin_z));
+        __m128d t = _mm_div_pd(_mm_sub_pd(_mm_loadu_pd(packet->D + i), distance), deno);
+        __m128d dp_x = _mm_sub_pd(_mm_add_pd(origin_x, _mm_mul_pd(direction_x, t)), _mm_loadu_pd(packet->Q[0] + i));
+        __m128d dp_y = _mm_sub_pd(_mm_add_pd(origin_y, _mm_mul_pd(direction_y, t)), _mm_loadu_pd(packet->Q[1] + i));
+        __m128d dp_z = _mm_sub_pd(_mm_add_pd(origin_z, _mm_mul_pd(direction_z, t)), _mm_loadu_pd(packet->Q[2] + i));
+        __m128d alpha = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dp_x, _mm_loadu_pd(packet->A[0] + i)),
+                                              _mm_mul_pd(dp_y, _mm_loadu_pd(packet->A[1] + i))),
+                                   _mm_mul_pd(dp_z, _mm_loadu_pd(packet->A[2] + i)));
+        __m128d beta = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dp_x, _mm_loadu_pd(packet->B[0] + i)),
+                                             _mm_mul_pd(dp_y, _mm_loadu_pd(packet->B[1] + i))),
+                                  _mm_mul_pd(dp_z, _mm_loadu_pd(packet->B[2] + i)));
+        __m128d lower = _mm_loadu_pd(packet->lower + i);
+        // the comparisons are false for NaN, so a zero deno (unused lane or parallel ray) never passes
+        __m128d inside = _mm_cmpge_pd(_mm_andnot_pd(sign_bit, deno), epsilon);
+        inside = _mm_and_pd(inside, _mm_and_pd(_mm_cmpgt_pd(t, t_min), _mm_cmplt_pd(t, t_max)));
+        inside = _mm_and_pd(inside, _mm_and_pd(_mm_cmpge_pd(alpha, lower), _mm_cmple_pd(alpha, one)));
+        inside = _mm_and_pd(inside, _mm_and_pd(_mm_cmpge_pd(beta, lower), _mm_cmple_pd(beta, one)));
+        inside = _mm_and_pd(inside, _mm_cmple_pd(_mm_add_pd(alpha, beta), _mm_loadu_pd(packet->sum_limit + i)));
+        inside = _mm_and_pd(inside, _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(alpha, alpha), _mm_mul_pd(beta, beta)),
+                                                 _mm_loadu_pd(packet->radius_limit + i)));
+        _mm_storeu_pd(out_t + i, t);
+        _mm_storeu_pd(out_alpha + i, alpha);
+        _mm_storeu_pd(out_beta + i, beta);
+        mask |= (u32)_mm_movemask_pd(inside) << i;
+    }
+    return mask;
+}
+
+TARGET_AVX2 u32 bvh_wide_packet_kernel_avx2(const bvh_wide_packet* packet, const ray* r, interval r_t, f64* out_t, f64* out_alpha, f64* out_beta) {
+    // the whole packet in one pass
+    __m256d origin_x = _mm256_set1_pd(r->origin.x);
+    __m256d origin_y = _mm256_set1_pd(r->origin.y);
+    __m256d origin_z = _mm256_set1_pd(r->origin.z);
+    __m256d direction_x = _mm256_set1_pd(r->direction.x);
+    __m256d direction_y = _mm256_set1_pd(r->direction.y);
+    __m256d direction_z = _mm256_set1_pd(r->direction.z);
+    __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d normal_x = _mm256_loadu_pd(packet->normal[0]);
+    __m256d normal_y = _mm256_loadu_pd(packet->normal[1]);
+    __m256d normal_z = _mm256_loadu_pd(packet->normal[2]);
+    __m256d deno = _mm256_fmadd_pd(normal_z, direction_z, _mm256_fmadd_pd(normal_y, direction_y, _mm256_mul_pd(normal_x, direction_x)));
+    __m256d distance = _mm256_fmadd_pd(normal_z, origin_z, _mm256_fmadd_pd(normal_y, origin_y, _mm256_mul_pd(normal_x, origin_x)));
+    __m256d t = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(packet->D), distance), deno);
+    __m256d dp_x = _mm256_sub_pd(_mm256_fmadd_pd(direction_x, t, origin_x), _mm256_loadu_pd(packet->Q[0]));
+    __m256d dp_y = _mm256_sub_pd(_mm256_fmadd_pd(direction_y, t, origin_y), _mm256_loadu_pd(packet->Q[1]));
+    __m256d dp_z = _mm256_sub_pd(_mm256_fmadd_pd(direction_z, t, origin_z), _mm256_loadu_pd(packet->Q[2]));
+    __m256d alpha = _mm256_fmadd_pd(dp_z, _mm256_loadu_pd(packet->A[2]),
+                                    _mm256_fmadd_pd(dp_y, _mm256_loadu_pd(packet->A[1]), _mm256_mul_pd(dp_x, _mm256_loadu_pd(packet->A[0]))));
+    __m256d beta = _mm256_fmadd_pd(dp_z, _mm256_loadu_pd(packet->B[2]),
+                                   _mm256_fmadd_pd(dp_y, _mm256_loadu_pd(packet->B[1]), _mm256_mul_pd(dp_x, _mm256_loadu_pd(packet->B[0]))));
+    __m256d lower = _mm256_loadu_pd(packet->lower);
+    __m256d inside = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), deno), _mm256_set1_pd(DBL_EPSILON), _CMP_GE_OQ);
+    inside = _mm256_and_pd(inside, _mm256_cmp_pd(t, _mm256_set1_pd(r_t.min), _CMP_GT_OQ));
+    inside = _mm256_and_pd(inside, _mm256_cmp_pd(t, _mm256_set1_pd(r_t.max), _CMP_LT_OQ));
+    inside = _mm256_and_pd(inside, _mm256_and_pd(_mm256_cmp_pd(alpha, lower, _CMP_GE_OQ), _mm256_cmp_pd(alpha, one, _CMP_LE_OQ)));
+    inside = _mm256_and_pd(inside, _mm256_and_pd(_mm256_cmp_pd(beta, lower, _CMP_GE_OQ), _mm256_cmp_pd(beta, one, _CMP_LE_OQ)));
+    inside = _mm256_and_pd(inside, _mm256_cmp_pd(_mm256_add_pd(alpha, beta), _mm256_loadu_pd(packet->sum_limit), _CMP_LE_OQ));
+    inside = _mm256_and_pd(inside, _mm256_cmp_pd(_mm256_fmadd_pd(beta, beta, _mm256_mul_pd(alpha, alpha)),
+                                                 _mm256_loadu_pd(packet->radius_limit), _CMP_LE_OQ));
+    _mm256_storeu_pd(out_t, t);
+    _mm256_storeu_pd(out_alpha, alpha);
+    _mm256_storeu_pd(out_beta, beta);
+    return (u32)_mm256_movemask_pd(inside);
+}
+
+#endif
+
+/// occlusion = true is the any hit test: the first hit returns, record is not used and the children are not sorted
+INLINE bool bvh_wide_traverse(hittable* object, ray* r_in, interval r_t, hit_record* record, bool occlusion,
+                              PFN_bvh_wide_kernel kernel, PFN_bvh_wide_packet_kernel packet_kernel) {
+    bvh_wide* wide = (bvh_wide*)object;
+    bvh_wide_ray r = {
+        .origin = {(f32)r_in->origin.x, (f32)r_in->origin.y, (f32)r_in->origin.z},
+        .inv_direction = {(f32)r_in->inv_direction.x, (f32)r_in->inv_direction.y, (f32)r_in->inv_direction.z},
+        .sign = r_in->sign,
+        .t_min = zfloat_round_down(r_t.min),
+        .t_max = zfloat_round_up(r_t.max),
+    };
+
+    bvh_wide_entry stack[BVH_WIDE_STACK_SIZE];
+    u32 stack_size = 0;
+    stack[stack_size++] = (bvh_wide_entry){0, 0, r.t_min};
+    bool hit_anything = false;
+    while (stack_size != 0) {
+        bvh_wide_entry entry = stack[--stack_size];
+        if (entry.t_near > r.t_max) {
+            continue; // something closer was hit after this was pushed
+        }
+        if (entry.leaf != 0) {
+            const bvh_wide_leaf* leaf = wide->leaves + entry.child;
+            for (u32 i = 0; i < leaf->packet_count; ++i) {
+                const bvh_wide_packet* packet = wide->packets + leaf->first_packet + i;
+                f64 t[BVH_WIDE_PACKET_SIZE], alpha[BVH_WIDE_PACKET_SIZE], beta[BVH_WIDE_PACKET_SIZE];
+                u32 mask = packet_kernel(packet, r_in, r_t, t, alpha, beta);
+                if (occlusion) {
+                    if (mask != 0) {
+                        return true;
+                    }
+                    continue;
+                }
+                i32 nearest = -1;
+                while (mask != 0) {
+                    u32 lane = __builtin_ctz(mask);
+                    mask &= mask - 1;
+                    if (t[lane] < r_t.max) {
+                        r_t.max = t[lane];
+                        nearest = lane;
+                    }
+                }
+                if (nearest >= 0) {
+                    bvh_wide_packet_record(packet, nearest, t[nearest], alpha[nearest], beta[nearest], record);
+                    hit_anything = true;
+                    r.t_max = zfloat_round_up(r_t.max);
+                }
+            }
+            for (u32 i = 0; i < leaf->object_count; ++i) {
+                hittable* leaf_object = wide->objects[leaf->first_object + i];
+                if (occlusion) {
+                    if (leaf_object->occluded(leaf_object, r_in, r_t)) {
+                        return true;
+                    }
+                    continue;
+                }
+                if (leaf_object->hit(leaf_object, r_in, r_t, record)) {
+                    hit_anything = true;
+                    r_t.max = record->t;
+                    r.t_max = zfloat_round_up(record->t);
+                }
+            }
+            continue;
+        }
+
+        const f32* node = (const f32*)(wide->nodes + (u64)entry.child * wide->node_size);
+        const u32* child = (const u32*)(node + 6 * wide->width);
+        const u32* leaf = child + wide->width;
+        f32 t_near[BVH_WIDE_MAX_WIDTH];
+        u32 mask = kernel(node, wide->width, &r, t_near);
+        if (occlusion) {
+            while (mask != 0) {
+                u32 i = __builtin_ctz(mask);
+                mask &= mask - 1;
+                stack[stack_size++] = (bvh_wide_entry){child[i], leaf[i], t_near[i]};
+            }
+            continue;
+        }
+
+        // push the hit children farthest first so the nearest one is popped next
+        bvh_wide_entry hits[BVH_WIDE_MAX_WIDTH];
+        u32 hit_count = 0;
+        while (mask != 0) {
+            u32 i = __builtin_ctz(mask);
+            mask &= mask - 1;
+            bvh_wide_entry hit = {child[i], leaf[i], t_near[i]};
+            u32 j = hit_count++;
+            for (; j > 0 && hits[j - 1].t_near < hit.t_near; --j) {
+                hits[j] = hits[j - 1];
+            }
+            hits[j] = hit;
+        }
+        for (u32 i = 0; i < hit_count; ++i) {
+            stack[stack_size++] = hits[i];
+        }
+    }
+    return hit_anything;
+}
+
+bool bvh_wide_hit_scalar(hittable* object, ray* r_in, interval r_t, hit_record* record) {
+    return bvh_wide_traverse(object, r_in, r_t, record, false, bvh_wide_kernel_scalar, bvh_wide_packet_kernel_scalar);
+}
+
+bool bvh_wide_occluded_scalar(hittable* object, ray* r_in, interval r_t) {
+    return bvh_wide_traverse(object, r_in, r_t, 0, true, bvh_wide_kernel_scalar, bvh_wide_packet_kernel_scalar);
+}
+
+#ifdef BVH_WIDE_X86
+
+TARGET_SSE bool bvh_wide_hit_sse(hittable* object, ray* r_in, interval r_t, hit_record* record) {
+    return bvh_wide_traverse(object, r_in, r_t, record, false, bvh_wide_kernel_sse, bvh_wide_packet_kernel_sse);
+}
+
+TARGET_SSE bool bvh_wide_occluded_sse(hittable* object, ray* r_in, interval r_t) {
+    return bvh_wide_traverse(object, r_in, r_t, 0, true, bvh_wide_kernel_sse, bvh_wide_packet_kernel_sse);
+}
+
+TARGET_AVX2 bool bvh_wide_hit_avx2(hittable* object, ray* r_in, interval r_t, hit_record* record) {
+    return bvh_wide_traverse(object, r_in, r_t, record, false, bvh_wide_kernel_avx2, bvh_wide_packet_kernel_avx2);
+}
+
+TARGET_AVX2 bool bvh_wide_occluded_avx2(hittable* object, ray* r_in, interval r_t) {
+    return bvh_wide_traverse(object, r_in, r_t, 0, true, bvh_wide_kernel_avx2, bvh_wide_packet_kernel_avx2);
+}
+
+/// 4 wide nodes on an AVX2 cpu, SSE for the boxes and AVX2 for the packets
+TARGET_AVX2 bool bvh_wide_hit_sse_avx2(hittable* object, ray* r_in, interval r_t, hit_record* record) {
+    return bvh_wide_traverse(object, r_in, r_t, record, false, bvh_wide_kernel_sse, bvh_wide_packet_kernel_avx2);
+}
+
+TARGET_AVX2 bool bvh_wide_occluded_sse_avx2(hittable* object, ray* r_in, interval r_t) {
+    return bvh_wide_traverse(object, r_in, r_t, 0, true, bvh_wide_kernel_sse, bvh_wide_packet_kernel_avx2);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef BVH_WIDE__H
+#define BVH_WIDE__H
+
+#include "defines.h"
+#include "bvh.h"
+
+/**
+ * @brief 4 or 8 wide bvh collapsed from a binary bvh (from either builder)
+ * every node stores the bounds of its children in SoA form (min x of all children, then min y, ...)
+ * so one SIMD pass tests the ray against all of them, hit children are visited nearest first
+ * the kernel is picked at runtime from the cpu features: AVX2 for 8 wide, SSE for 4 wide, scalar otherwise
+ * quads, triangles and circles in the leaves are grouped in SoA packets of 4 and a ray is tested against a whole
+ * packet at once (AVX2, SSE or scalar in double precision), small subtrees of them are collapsed into one leaf
+ */
+
+/// width = 0 picks 8 when the cpu has AVX2 and 4 otherwise
+/// the source bvh is not needed anymore after this and can be destroyed
+hittable* bvh_wide_create(hittable* bvh, u32 width);
+
+void bvh_wide_destroy(hittable* wide);
+
+#endif
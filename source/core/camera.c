@@ -3,9 +3,11 @@
 #include "zmemory.h"
 #include "hittable_list.h"
 #include "platform.h"
-#include "zthread.h"
+#include "zthread_pool.h"
+#include "zatomic.h"
 #include "material.h"
 #include "clock.h"
+#include "zimage.h"
 
 /////////////////////////////////////////////////////////////////////
 //   _______   ______   _____  ____    ______    ______   ______   //
@@ -18,36 +20,189 @@
 //                                                                 //
 /////////////////////////////////////////////////////////////////////
 
-#define BYTES_PER_PIXEL 12 // "255 255 255" (including spaces)
-#define PIXEL_DATA_SIZE (BYTES_PER_PIXEL + 4)
-#define GAMMA 0.5
+#define DEFAULT_TILE_SIZE 16
+#define MAX_PATH_LENGTH 256
+// paths are never stopped before this many bounces, then they survive with the probability of their brightest channel
+#define RUSSIAN_ROULETTE_MIN_BOUNCES 3
+#define RUSSIAN_ROULETTE_MAX_SURVIVAL 0.95
+// adaptive sampling stops a pixel once 1.96 standard errors (95% confidence) are below the relative error,
+// pixels darker than the floor are measured against the floor so near black pixels don't chase tiny means
+#define ADAPTIVE_CONFIDENCE_SCALE 1.96
+#define ADAPTIVE_LUMINANCE_FLOOR 0.01
+// stream index of the per pixel shift of the adaptive sample positions, past any real sample index
+#define ADAPTIVE_SHIFT_INDEX 0xffffffffffffffffULL
+// steps of the R2 low discrepancy sequence, 1/g and 1/g^2 with g the plastic number
+#define R2_STEP_X 0.75487766624669276005
+#define R2_STEP_Y 0.56984029099805326591
+// a progressive render writes <name>.partial.ppm after every pass, through a temporary file that replaces it
+#define SNAPSHOT_EXTENSION "partial.ppm"
+#define SNAPSHOT_TEMP_EXTENSION "partial.ppm.tmp"
+// the checkpoint of a render goes to <name>.checkpoint the same way
+#define CHECKPOINT_EXTENSION "checkpoint"
+#define CHECKPOINT_TEMP_EXTENSION "checkpoint.tmp"
+#define CHECKPOINT_MAGIC 0x4b435a52 // "RZCK"
+#define CHECKPOINT_VERSION 2
+// pass size of a checkpointed render that didn't ask for progressive passes
+#define CHECKPOINT_SAMPLES_PER_PASS 16
+
+#define SHARD_EXTENSION "shard%d"
+#define SHARD_TEMP_EXTENSION "shard%d.tmp"
+#define SHARD_CHECKPOINT_EXTENSION "shard%d.checkpoint"
+#define SHARD_CHECKPOINT_TEMP_EXTENSION "shard%d.checkpoint.tmp"
+#define SHARD_MAGIC 0x48535a52 // "RZSH"
+#define SHARD_VERSION 2
+#define MAX_EXTENSION_LENGTH 32
+// a time budgeted render starts with a pilot pass of this many samples to measure the cost of a sample,
+// then every pass takes the samples that fit in this fraction of the time left
+#define TIME_BUDGET_PILOT_SAMPLES 1
+#define TIME_BUDGET_MARGIN 0.9
+
+/// weight of a sample from the strategy with pdf_a when the other strategy could have picked it with pdf_b
+INLINE f64 power_heuristic(f64 pdf_a, f64 pdf_b) {
+    f64 a = pdf_a * pdf_a;
+    f64 b = pdf_b * pdf_b;
+    return a / (a + b);
+}
+
+/// samples rounded up to whole batches of adaptive sampling (batch 0 when it's off)
+INLINE i32 round_up_to_batch(i32 samples, i32 batch) {
+    return batch ? (samples + batch - 1) / batch * batch : samples;
+}
+
+/// samples rounded down to whole batches of adaptive sampling (batch 0 when it's off)
+INLINE i32 round_down_to_batch(i32 samples, i32 batch) {
+    return batch ? samples / batch * batch : samples;
+}
 
 typedef struct camera {
     i32 image_width;
     i32 image_height;
+    i32 tile_size;
     point3 pixel_00;
     vec3 delta_x;
     vec3 delta_y;
     vec3 origin;
     f64 inv_sqrt_spp;
+    i32 adaptive_min_samples; // batch size of adaptive sampling, 0 when every pixel gets samples_per_pixel
+    f64 adaptive_error;
+    i32 samples_per_pass; // progressive rendering, 0 renders all the samples in one pass
+    f64 checkpoint_interval; // seconds between checkpoints, 0 writes none
+    bool resume; // continue from the checkpoint of the same file name if there is one
+    f64 time_budget; // seconds a render may take, 0 for no limit
+    i32 shard_index; // sharded rendering: only the tiles with tile % shard_count == shard_index are rendered
+    i32 shard_count; // 0 renders the whole image
     color (*background)(ray* r_in);
+    zimage framebuffer; // linear rgb, written straight to the output files
+#ifdef MULTITHREADING
+    zthread_pool pool; // workers are kept alive between renders
+#endif
 } camera;
 
+/// running sums of one pixel's samples, kept between the passes of a progressive render
+typedef struct pixel_accumulator {
+    color sum; // sum of the samples
+    f64 mean;  // running mean of the sample luminance (welford)
+    f64 m2;    // sum of squared differences of the sample luminance from the mean
+    i32 count; // samples taken so far, the next sample has this index
+    i32 converged; // adaptive sampling is done with the pixel
+} pixel_accumulator;
+
+/**
+ * @brief a checkpoint file is this header followed by the pixel_accumulator of every pixel (raw, native byte order),
+ * the random streams are counter based so the seed and the per pixel counts are the whole rng state
+ */
+typedef struct checkpoint_header {
+    u32 magic;
+    u32 version;
+    u32 accumulator_size; // sizeof(pixel_accumulator) of the build that wrote it
+    i32 image_width;
+    i32 image_height;
+    i32 depth;
+    i32 adaptive_min_samples;
+    i32 sample_end; // samples per pixel reached (converged pixels have fewer)
+    i32 shard_index;
+    i32 shard_count;
+    f64 adaptive_error;
+    f64 field_of_view;
+    point3 look_from;
+    point3 look_at;
+    vec3 world_up;
+    u64 seed;
+} checkpoint_header;
+
+/**
+ * @brief a shard file is this header followed by a shard_pixel for every pixel of the shard's own tiles (tile by tile,
+ * rows within a tile, see camera_shard_pixels), so the shards of an image together are about one image in size,
+ * camera_merge_shards puts them back together
+ */
+typedef struct shard_header {
+    u32 magic;
+    u32 version;
+    u32 pixel_size; // sizeof(shard_pixel) of the build that wrote it
+    i32 image_width;
+    i32 image_height;
+    i32 tile_size;
+    i32 shard_index;
+    i32 shard_count;
+    u64 pixel_count; // shard_pixels that follow
+    u64 seed;
+} shard_header;
+
+typedef struct shard_pixel {
+    f32 value[3]; // the framebuffer pixel, linear rgb
+    i32 weight;   // samples taken
+} shard_pixel;
+
 typedef struct camera_thread_params {
-    char* buffer;
-    i32 buffer_size;
-    camera* cam;
+    camera* cam; // every tile writes only its own pixels of cam->framebuffer
     hittable_list* world;
-    i32 width;
-    i32 height_start;
-    i32 height_end;
     i32 depth;
     i32 sqrt_spp;
+    i32 max_samples; // samples_per_pixel, the cap of adaptive sampling
+    i32 sample_end;  // progressive: the current pass samples every pixel up to this count
+    pixel_accumulator* accumulators; // progressive: one per pixel, 0 when the image is rendered in one pass
+    i32 tiles_per_row;
+    i32 tile_count;  // tiles of this shard
+    i32 shard_index; // the shard's tiles are shard_index, shard_index + shard_count, ...
+    i32 shard_count; // 1 renders every tile
+    i32* weights;    // sharded: samples taken per pixel, written to the shard file
+    volatile i32* next_tile;  // shared tile counter, each worker pulls the next tile from it
+    volatile i32* tiles_done; // used only for progress
+    volatile i64* samples_done; // used only to report the average spp of adaptive sampling
 } camera_thread_params;
 
-ray generate_ray(camera* cam, i32 width, i32 height, i32 row_s, i32 col_s);
+ray generate_ray(camera* cam, i32 width, i32 height, f64 dx, f64 dy);
 color get_pixel_color(camera* cam, ray* r, i32 depth, hittable_list* world);
-zthread_func_return_type camera_thread_start_func(void* params);
+color sample_light(hittable_list* world, ray* r_in, hit_record* record);
+i64 render_tile(camera_thread_params* params, i32 tile);
+i32 render_pixel_samples(camera_thread_params* params, i32 width, i32 height, pixel_accumulator* accumulator, i32 sample_end);
+bool camera_render_pass(camera* cam, camera_thread_params* shared);
+void camera_render_job(void* params);
+void camera_write_snapshot(camera* cam, const char* file_path);
+bool camera_write_checkpoint(camera* cam, const char* file_path, checkpoint_header* header, pixel_accumulator* accumulators);
+bool camera_read_checkpoint(camera* cam, const char* file_path, checkpoint_header* header, pixel_accumulator* accumulators);
+bool camera_checkpoint_path(camera* cam, char* out_path, const char* file_path, bool temp);
+bool camera_write_shard(camera* cam, const char* file_path, u64 seed, i32* weights);
+bool camera_shard_path(char* out_path, const char* file_path, i32 shard_index, bool temp);
+u64 camera_shard_pixels(i32 width, i32 height, i32 tile_size, i32 shard_index, i32 shard_count, u64* out_indices);
+void camera_write_image(zimage* image, const char* file_path);
+void camera_resolve(camera* cam, pixel_accumulator* accumulators);
+f64 camera_error_estimate(camera* cam, pixel_accumulator* accumulators);
+
+static camera_options default_options = {0};
+
+void camera_set_default_options(const camera_options* options) {
+    if (!options || options->samples_per_pass < 0 || options->checkpoint_interval < 0.0 || options->time_budget < 0.0 ||
+        options->shard_count < 0 || (options->shard_count && (options->shard_index < 0 || options->shard_index >= options->shard_count))) {
+        LOGE("camera_set_default_options: invalid params");
+        return;
+    }
+    default_options = *options;
+    if (default_options.shard_count == 0) {
+        default_options.shard_index = 0;
+    }
+}
+bool camera_output_path(char* out_path, const char* file_path, const char* extension);
 
 camera* camera_create(i32 image_width, i32 image_height) {
     if (image_height <= 0 || image_width <= 0) {
@@ -57,6 +212,26 @@ camera* camera_create(i32 image_width, i32 image_height) {
     camera* cam = zmemory_allocate(sizeof(camera));
     cam->image_width = image_width;
     cam->image_height = image_height;
+    cam->tile_size = DEFAULT_TILE_SIZE;
+    cam->samples_per_pass = default_options.samples_per_pass;
+    cam->checkpoint_interval = default_options.checkpoint_interval;
+    cam->resume = default_options.resume;
+    cam->time_budget = default_options.time_budget;
+    cam->shard_index = default_options.shard_index;
+    cam->shard_count = default_options.shard_count;
+    if (!zimage_create(image_width, image_height, &cam->framebuffer)) {
+        LOGE("camera_create: failed to create framebuffer");
+        zmemory_free(cam, sizeof(camera));
+        return 0;
+    }
+#ifdef MULTITHREADING
+    if (!zthread_pool_create(0, &cam->pool)) {
+        LOGE("camera_create: failed to create thread pool");
+        zimage_destroy(&cam->framebuffer);
+        zmemory_free(cam, sizeof(camera));
+        return 0;
+    }
+#endif
     return cam;
 }
 
@@ -65,29 +240,73 @@ void camera_destroy(camera* cam) {
         LOGE("camera_destroy: invalid params");
         return;
     }
+#ifdef MULTITHREADING
+    zthread_pool_destroy(&cam->pool);
+#endif
+    zimage_destroy(&cam->framebuffer);
     zmemory_free(cam, sizeof(camera));
 }
 
-void camera_render(camera* cam, hittable_list* world, const char* file_path,
-                   f64 viewport_field_of_view, point3 look_from, point3 look_at, vec3 world_up,
-                   i32 samples_per_pixel, i32 depth, color (*background)(ray* r_in)) {
+void camera_set_tile_size(camera* cam, i32 tile_size) {
+    if (!cam || tile_size <= 0) {
+        LOGE("camera_set_tile_size: invalid params");
+        return;
+    }
+    cam->tile_size = tile_size;
+}
+
+void camera_set_adaptive_sampling(camera* cam, i32 min_samples, f64 relative_error) {
+    // the variance needs at least 2 samples
+    if (!cam || min_samples < 2 || relative_error < 0.0) {
+        LOGE("camera_set_adaptive_sampling: invalid params");
+        return;
+    }
+    cam->adaptive_min_samples = relative_error > 0.0 ? min_samples : 0;
+    cam->adaptive_error = relative_error;
+}
+
+void camera_set_progressive(camera* cam, i32 samples_per_pass) {
+    if (!cam || samples_per_pass < 0) {
+        LOGE("camera_set_progressive: invalid params");
+        return;
+    }
+    cam->samples_per_pass = samples_per_pass;
+}
+
+void camera_set_checkpoint(camera* cam, f64 interval_seconds, bool resume) {
+    if (!cam || interval_seconds < 0.0) {
+        LOGE("camera_set_checkpoint: invalid params");
+        return;
+    }
+    cam->checkpoint_interval = interval_seconds;
+    cam->resume = resume;
+}
+
+void camera_set_time_budget(camera* cam, f64 seconds) {
+    if (!cam || seconds < 0.0) {
+        LOGE("camera_set_time_budget: invalid params");
+        return;
+    }
+    cam->time_budget = seconds;
+}
 
-    char ppm[100] = {0};
-    i32 i;
-    for (i = 0; file_path[i] != '\0' && file_path[i] != '.'; ++i) {
-        ppm[i] = file_path[i];
+void camera_set_shard(camera* cam, i32 shard_index, i32 shard_count) {
+    if (!cam || shard_count < 0 || (shard_count && (shard_index < 0 || shard_index >= shard_count))) {
+        LOGE("camera_set_shard: invalid params");
+        return;
     }
-    ppm[i++] = '.';
-    ppm[i++] = 'p';
-    ppm[i++] = 'p';
-    ppm[i++] = 'm';
+    cam->shard_index = shard_count ? shard_index : 0;
+    cam->shard_count = shard_count;
+}
 
-    FILE* file = file_open(ppm, 0, FILE_MODE_READ_AND_WRITE);
+void camera_render(camera* cam, hittable_list* world, const char* file_path,
+                   f64 viewport_field_of_view, point3 look_from, point3 look_at, vec3 world_up,
+                   i32 samples_per_pixel, i32 depth, color (*background)(ray* r_in)) {
 
     clock clk;
     clock_set(&clk);
 
-    if (cam == 0 || file == 0 || world == 0 || viewport_field_of_view <= 0.0 | samples_per_pixel <= 0 || depth <= 0) {
+    if (cam == 0 || file_path == 0 || world == 0 || viewport_field_of_view <= 0.0 || samples_per_pixel <= 0 || depth <= 0) {
         LOGE("camera_render: invalid params");
         return;
     }
@@ -119,105 +338,182 @@ void camera_render(camera* cam, hittable_list* world, const char* file_path,
     i32 sqrt_spp = (i32)zsqrt(samples_per_pixel);
     cam->inv_sqrt_spp = 1.0 / sqrt_spp;
 
-#ifndef MULTITHREADING
-    // using single thread
-    LOGI("generating image data on single thread...");
-
-    f64 pixel_sample_scale = 1.0f / (sqrt_spp * sqrt_spp);
-
-    for (i32 height = 0; height < cam->image_height; ++height) {
-        LOG_STDOUT("\rremaning scanlines %u                      ", cam->image_height - height);
+    // the image is split into small square tiles, workers keep pulling the next tile
+    // from a shared counter so expensive regions are spread over all the threads
+    volatile i32 next_tile = 0;
+    volatile i32 tiles_done = 0;
+    volatile i64 samples_done = 0;
+    i32 tiles_per_row = (cam->image_width + cam->tile_size - 1) / cam->tile_size;
+    i32 tiles_per_column = (cam->image_height + cam->tile_size - 1) / cam->tile_size;
+    // a shard renders every shard_count-th tile, interleaved so every shard gets a similar mix of cheap and
+    // expensive regions, its pixels keep the samples (and random streams) they get in a single process render
+    bool sharded = cam->shard_count > 0;
+    i32 shard_count = sharded ? cam->shard_count : 1;
+    i32 shard_tile_count = (tiles_per_row * tiles_per_column - cam->shard_index + shard_count - 1) / shard_count;
+    i32* weights = 0;
+    u64 weights_size = (u64)cam->image_width * cam->image_height * sizeof(i32);
+    if (sharded) {
+        weights = zmemory_allocate(weights_size);
+    }
 
-        for (i32 width = 0; width < cam->image_width; ++width) {
-            color pixel_color = {0.0, 0.0, 0.0};
-            for (i32 row_s = 0; row_s < sqrt_spp; ++row_s) {
-                for (i32 col_s = 0; col_s < sqrt_spp; ++col_s) {
-                    ray r = generate_ray(cam, width, height, row_s, col_s);
-                    color c = get_pixel_color(cam, &r, depth, world);
-                    pixel_color = vec3_add(pixel_color, c);
-                }
-            }
-            pixel_color = vec3_mul_scalar(pixel_sample_scale, pixel_color); // take the average of all samples
-            // gamma correction
-            pixel_color.x = zpow(pixel_color.x, GAMMA);
-            pixel_color.y = zpow(pixel_color.y, GAMMA);
-            pixel_color.z = zpow(pixel_color.z, GAMMA);
-            i32 r = (i32)(255.9999 * pixel_color.x);
-            i32 g = (i32)(255.9999 * pixel_color.y);
-            i32 b = (i32)(255.9999 * pixel_color.z);
-            LOG_FILE(file, "%d %d %d\n", r, g, b);
+    // a progressive render keeps every pixel's sums between the passes and resolves the framebuffer after each one,
+    // a checkpoint is a copy of those sums
+    bool checkpointing = cam->checkpoint_interval > 0.0 || cam->resume;
+    bool budgeted = cam->time_budget > 0.0;
+    pixel_accumulator* accumulators = 0;
+    u64 accumulators_size = (u64)cam->image_width * cam->image_height * sizeof(pixel_accumulator);
+    i32 samples_per_pass = samples_per_pixel;
+    if (cam->samples_per_pass || checkpointing || budgeted) {
+        accumulators = zmemory_allocate(accumulators_size);
+        if (cam->samples_per_pass) {
+            samples_per_pass = cam->samples_per_pass;
+        } else if (cam->checkpoint_interval > 0.0) {
+            // checkpoints land between whole adaptive batches, --resume alone renders the rest in one pass
+            samples_per_pass = round_up_to_batch(CHECKPOINT_SAMPLES_PER_PASS, cam->adaptive_min_samples);
+        }
+    }
+    if (!accumulators && !cam->adaptive_min_samples && sqrt_spp * sqrt_spp != samples_per_pixel) {
+        // the one pass render stratifies the samples in a sqrt_spp x sqrt_spp grid
+        LOGW("camera_render: %d samples per pixel are rendered as %dx%d = %d", samples_per_pixel, sqrt_spp, sqrt_spp, sqrt_spp * sqrt_spp);
+    }
+    checkpoint_header header = {
+        .magic = CHECKPOINT_MAGIC,
+        .version = CHECKPOINT_VERSION,
+        .accumulator_size = sizeof(pixel_accumulator),
+        .image_width = cam->image_width,
+        .image_height = cam->image_height,
+        .depth = depth,
+        .adaptive_min_samples = cam->adaptive_min_samples,
+        .shard_index = cam->shard_index,
+        .shard_count = cam->shard_count,
+        .adaptive_error = cam->adaptive_error,
+        .field_of_view = viewport_field_of_view,
+        .look_from = look_from,
+        .look_at = look_at,
+        .world_up = world_up,
+        .seed = random_seed_get(),
+    };
+    if (cam->resume && camera_read_checkpoint(cam, file_path, &header, accumulators)) {
+        // the rest of the samples continue the streams of the checkpointed ones
+        random_seed_set(header.seed);
+        for (u64 i = 0; i < (u64)cam->image_width * cam->image_height; ++i) {
+            samples_done += accumulators[i].count;
         }
+        LOGI("resuming from %d samples per pixel, random seed = %llu", header.sample_end, header.seed);
+    }
+    i32 sample_end = header.sample_end;
+    i32 pass_samples = samples_per_pass;
+    if (budgeted) {
+        // with adaptive sampling the pilot is a whole batch, a pixel is never tested before min_samples
+        pass_samples = round_up_to_batch(MIN(TIME_BUDGET_PILOT_SAMPLES, samples_per_pass), cam->adaptive_min_samples);
     }
+    f64 deadline = clk.start_time + cam->time_budget;
+
+    camera_thread_params shared = {
+        .cam = cam,
+        .world = world,
+        .depth = depth,
+        .sqrt_spp = sqrt_spp,
+        .max_samples = samples_per_pixel,
+        .accumulators = accumulators,
+        .tiles_per_row = tiles_per_row,
+        .tile_count = shard_tile_count,
+        .shard_index = cam->shard_index,
+        .shard_count = shard_count,
+        .weights = weights,
+        .next_tile = &next_tile,
+        .tiles_done = &tiles_done,
+        .samples_done = &samples_done,
+    };
 
+#ifndef MULTITHREADING
+    LOGI("generating image data on single thread...");
 #else
-    // using multithread
     LOGI("generating image data on multi threads...");
-
-    i32 cpu_count = platform_get_processor_count();
-    if (cpu_count <= 0) {
-        LOGE("Invalid processor count");
-        return;
-    }
-    i32 thread_height = (cam->image_height / cpu_count);
-    camera_thread_params params[cpu_count];
-    zthread threads[cpu_count];
-
-    for (i32 i = 0; i < cpu_count; ++i) {
-        params[i].cam = cam;
-        params[i].sqrt_spp = sqrt_spp;
-        params[i].depth = depth;
-        params[i].world = world;
-        params[i].width = cam->image_width;
-        params[i].height_start = i * thread_height;
-        // last thread must include remaining lines
-        if (i == cpu_count - 1) {
-            params[i].height_end = cam->image_height;
-        } else {
-            params[i].height_end = (i + 1) * thread_height;
-        }
-        // width*height*no_of_char_in(255 255 255\n)+extra_padding
-        params[i].buffer_size = (cam->image_width * (params[i].height_end - params[i].height_start) * PIXEL_DATA_SIZE);
-        params[i].buffer = zmemory_allocate(params[i].buffer_size);
-        if (params[i].buffer == 0) {
-            LOGE("camera_render: failed to allocate memory");
-            for (i32 j = 0; j < i; ++j) {
-                zmemory_free(params[j].buffer, params[j].buffer_size);
+#endif
+    f64 last_checkpoint = clk.start_time;
+    i32 pass = 0;
+    bool rendered = false;
+    while (pass_samples > 0 && sample_end < samples_per_pixel) {
+        shared.sample_end = MIN(sample_end + pass_samples, samples_per_pixel);
+        next_tile = 0;
+        tiles_done = 0;
+        f64 pass_start = platform_time();
+        if (!camera_render_pass(cam, &shared)) {
+            if (accumulators) {
+                zmemory_free(accumulators, accumulators_size);
+            }
+            if (weights) {
+                zmemory_free(weights, weights_size);
             }
             return;
         }
-
-        if (!zthread_create(camera_thread_start_func, &params[i], &threads[i])) {
-            LOGE("camera_render: failed to create a zthread");
-            for (i32 j = 0; j <= i; ++j) {
-                zmemory_free(params[j].buffer, params[j].buffer_size);
+        f64 pass_end = platform_time();
+        f64 seconds_per_sample = (pass_end - pass_start) / (shared.sample_end - sample_end);
+        sample_end = shared.sample_end;
+        rendered = true;
+        ++pass;
+        if (budgeted) {
+            // the last pass measured the cost of a sample per pixel, the next one takes what fits in the time left,
+            // only whole batches with adaptive sampling so it doesn't overshoot, none fitting ends the render
+            f64 affordable = (deadline - pass_end) * TIME_BUDGET_MARGIN / MAX(seconds_per_sample, 1e-9);
+            i32 affordable_samples = (i32)MAX(MIN(affordable, (f64)samples_per_pixel), 0.0);
+            pass_samples = MIN(round_down_to_batch(affordable_samples, cam->adaptive_min_samples), samples_per_pass);
+        }
+        bool last_pass = pass_samples <= 0 || sample_end >= samples_per_pixel;
+        if (accumulators && !last_pass) {
+            if (!sharded) { // a shard's image is mostly black
+                camera_write_snapshot(cam, file_path);
             }
-            return;
+            LOGI("\rpass %d done, %d samples per pixel after %lf sec       ", pass, sample_end, pass_end - clk.start_time);
+        }
+        // the last checkpoint lets a finished image get more samples later, it is the only one with an interval of 0
+        header.sample_end = sample_end;
+        if (checkpointing && (last_pass || (cam->checkpoint_interval > 0.0 && platform_time() - last_checkpoint >= cam->checkpoint_interval))) {
+            camera_write_checkpoint(cam, file_path, &header, accumulators);
+            last_checkpoint = platform_time();
         }
     }
-
-    if (!zthread_wait_on_all(threads, cpu_count)) {
-        LOGE("camera_render: threads wait failed");
+    if (budgeted) {
+        clock_update(&clk);
+        LOGI("\rtime budget: %d samples per pixel in %lf of %lf sec, mean relative error %lf (95%% confidence)       ",
+             sample_end, clk.elapsed, cam->time_budget, camera_error_estimate(cam, accumulators));
     }
-
-    for (i32 i = 0; i < cpu_count; ++i) {
-        zthread_destroy(&threads[i]); // does nothing important
+    if (accumulators) {
+        if (!rendered) {
+            camera_resolve(cam, accumulators); // the checkpoint already had every sample
+            for (u64 i = 0; weights && i < (u64)cam->image_width * cam->image_height; ++i) {
+                weights[i] = accumulators[i].count;
+            }
+        }
+        zmemory_free(accumulators, accumulators_size);
+        char snapshot_path[MAX_PATH_LENGTH];
+        if (camera_output_path(snapshot_path, file_path, SNAPSHOT_EXTENSION)) {
+            platform_file_remove(snapshot_path); // the final image replaces it
+        }
     }
 
-    LOGD("writing image data into file...");
-
-    LOG_FILE(file, "P3\n%d %d\n%d\n", cam->image_width, cam->image_height, 255);
-
-    for (i32 i = 0; i < cpu_count; ++i) {
-        LOG_FILE(file, "%s", params[i].buffer);
-    }
-    // dealloc memory
-    for (i32 i = 0; i < cpu_count; ++i) {
-        zmemory_free(params[i].buffer, params[i].buffer_size);
+    if (cam->adaptive_min_samples) {
+        u64 pixel_count = (u64)cam->image_width * cam->image_height;
+        u64 rendered_count = pixel_count;
+        for (u64 i = 0; weights && i < pixel_count; ++i) {
+            rendered_count -= weights[i] == 0; // another shard's pixel
+        }
+        f64 average_spp = samples_done / (f64)MAX(rendered_count, 1);
+        LOGI("\radaptive sampling: %lf samples per pixel on average (max %d)       ", average_spp, samples_per_pixel);
     }
 
-#endif
+    LOGD("\rwriting image data into file...                                    ");
 
-    file_close(file);
+    if (sharded) {
+        // the image is written by camera_merge_shards once every shard is done
+        if (camera_write_shard(cam, file_path, random_seed_get(), weights)) {
+            LOGI("shard %d/%d done", cam->shard_index, cam->shard_count);
+        }
+        zmemory_free(weights, weights_size);
+    } else {
+        camera_write_image(&cam->framebuffer, file_path);
+    }
 
     clock_update(&clk);
 
@@ -229,18 +525,6 @@ void camera_render(camera* cam, hittable_list* world, const char* file_path,
     } else {
         LOGD("time taken to render = %lf hrs", clk.elapsed / 3600);
     }
-
-#ifdef BMP
-    char bmp[100] = {0};
-    for (i = 0; file_path[i] != '\0'; ++i) {
-        bmp[i] = file_path[i];
-    }
-    bmp[i++] = '.';
-    bmp[i++] = 'b';
-    bmp[i++] = 'm';
-    bmp[i++] = 'p';
-    convert_ppm_to_bmp(ppm, bmp);
-#endif
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -259,65 +543,582 @@ void camera_render(camera* cam, hittable_list* world, const char* file_path,
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-ray generate_ray(camera* cam, i32 width, i32 height, i32 row_s, i32 col_s) {
-    f64 dx = (col_s + random_unit()) * cam->inv_sqrt_spp;
-    f64 dy = (row_s + random_unit()) * cam->inv_sqrt_spp;
+/// dx, dy is the sample's position inside the pixel in [0, 1)
+ray generate_ray(camera* cam, i32 width, i32 height, f64 dx, f64 dy) {
     point3 x = vec3_mul_scalar((width + dx - 0.5), cam->delta_x);
     point3 y = vec3_mul_scalar((height + dy - 0.5), cam->delta_y);
     point3 pixel_sample = vec3_add(cam->pixel_00, vec3_add(x, y));
-    return (ray){
-        .origin = cam->origin,
-        .direction = vec3_sub(pixel_sample, cam->origin),
-    };
+    return ray_create(cam->origin, vec3_sub(pixel_sample, cam->origin));
 }
 
 color get_pixel_color(camera* cam, ray* r, i32 depth, hittable_list* world) {
-    if (depth <= 0) {
+    // the path is followed in a loop, throughput is the product of the attenuations so far
+    // and scales everything the path picks up from here on
+    color radiance = vec3_zero();
+    color throughput = vec3_one();
+    ray current = *r;
+    // pdf the last bounce picked current's direction with, 0 for camera rays and mirror or glass bounces
+    // (those can't be light sampled so an emitter they hit keeps its full weight)
+    f64 scatter_pdf = 0.0;
+    bool sample_lights = darray_length(world->lights) > 0;
+    for (i32 bounce = 0; bounce < depth; ++bounce) {
+        // not cleared, the hit query and hittable_surface write every field that is read
+        hit_record record;
+        if (!hittable_list_hit(world, &current, (interval){0.0001, INFINITY}, &record)) {
+            return vec3_add(radiance, vec3_mul(throughput, cam->background(&current)));
+        }
+        hittable_surface(&current, &record);
+        color attenuation = {0};
+        ray scattered = {0};
+        color color_from_emmision = record.mat->emitted(record.mat, &record);
+        if (scatter_pdf > 0.0 && color_from_emmision.x + color_from_emmision.y + color_from_emmision.z > 0.0) {
+            // the light sampling of the previous bounce could have found this emitter too, the 2 share it
+            f64 light_pdf = hittable_list_light_pdf(world, &record, current.origin, current.direction);
+            color_from_emmision = vec3_mul_scalar(power_heuristic(scatter_pdf, light_pdf), color_from_emmision);
+        }
+        radiance = vec3_add(radiance, vec3_mul(throughput, color_from_emmision));
+        if (!record.mat->scatter(record.mat, &current, &record, &attenuation, &scattered)) {
+            return radiance;
+        }
+        scatter_pdf = 0.0;
+        if (sample_lights && record.mat->light_sampled) {
+            radiance = vec3_add(radiance, vec3_mul(throughput, sample_light(world, &current, &record)));
+            record.mat->eval(record.mat, &current, &record, scattered.direction, &scatter_pdf);
+        }
+        throughput = vec3_mul(throughput, attenuation);
+
+        // russian roulette: a dim path is stopped with probability 1 - p and a surviving one is scaled by 1 / p,
+        // so the expected value is unchanged but dark and absorbing paths end long before depth
+        if (bounce + 1 >= RUSSIAN_ROULETTE_MIN_BOUNCES) {
+            f64 p = MIN(MAX(MAX(throughput.x, throughput.y), throughput.z), RUSSIAN_ROULETTE_MAX_SURVIVAL);
+            if (random_unit() >= p) {
+                return radiance;
+            }
+            throughput = vec3_mul_scalar(1.0 / p, throughput);
+        }
+        current = scattered;
+    }
+    return radiance;
+}
+
+/**
+ * @brief next event estimation: picks a point on a random registered light and
+ * returns its direct light at the hit in record if nothing blocks it,
+ * weighted against the bsdf sampling that could have hit the same point (multiple importance sampling)
+ */
+color sample_light(hittable_list* world, ray* r_in, hit_record* record) {
+    i32 light_count = darray_length(world->lights);
+    hittable* light = world->lights[random_int(0, light_count)];
+    vec3 direction = light->sample(light, record->point);
+    // the bsdf first, a direction behind the surface doesn't need the light's pdf
+    f64 scatter_pdf;
+    color bsdf_cos = record->mat->eval(record->mat, r_in, record, direction, &scatter_pdf);
+    if (scatter_pdf <= 0.0) {
+        return vec3_zero();
+    }
+    f64 light_pdf = light->pdf(light, record->point, direction) / light_count;
+    if (light_pdf <= 0.0) {
+        return vec3_zero();
+    }
+    ray shadow = ray_create(record->point, direction);
+    hit_record light_record;
+    if (!light->hit(light, &shadow, (interval){0.0001, INFINITY}, &light_record)) {
         return vec3_zero();
     }
-    hit_record record = {0};
-    if (!hittable_list_hit(world, r, (interval){0.0001, INFINITY}, &record)) {
-        return cam->background(r);
+    // stop just short of the light so the light itself doesn't count as the blocker
+    if (hittable_list_occluded(world, &shadow, (interval){0.0001, light_record.t * (1.0 - 1e-4)})) {
+        return vec3_zero();
+    }
+    hittable_surface(&shadow, &light_record);
+    color emitted = light_record.mat->emitted(light_record.mat, &light_record);
+    f64 weight = power_heuristic(light_pdf, scatter_pdf) / light_pdf;
+    return vec3_mul_scalar(weight, vec3_mul(emitted, bsdf_cos));
+}
+
+i64 render_tile(camera_thread_params* params, i32 tile) {
+    camera* cam = params->cam;
+    i32 width_start = (tile % params->tiles_per_row) * cam->tile_size;
+    i32 height_start = (tile / params->tiles_per_row) * cam->tile_size;
+    i32 width_end = width_start + cam->tile_size;
+    i32 height_end = height_start + cam->tile_size;
+    width_end = (width_end < cam->image_width ? width_end : cam->image_width);
+    height_end = (height_end < cam->image_height ? height_end : cam->image_height);
+    f64 pixel_sample_scale = 1.0f / (params->sqrt_spp * params->sqrt_spp);
+    i64 samples = 0;
+
+    for (i32 height = height_start; height < height_end; ++height) {
+
+        for (i32 width = width_start; width < width_end; ++width) {
+            color pixel_color = {0.0, 0.0, 0.0};
+            i32 weight; // samples in the pixel's value
+
+            if (params->accumulators) {
+                pixel_accumulator* accumulator = &params->accumulators[(u64)height * cam->image_width + width];
+                samples += render_pixel_samples(params, width, height, accumulator, params->sample_end);
+                pixel_color = vec3_mul_scalar(1.0 / accumulator->count, accumulator->sum);
+                weight = accumulator->count;
+            } else if (cam->adaptive_min_samples) {
+                pixel_accumulator accumulator = {0};
+                samples += render_pixel_samples(params, width, height, &accumulator, params->max_samples);
+                pixel_color = vec3_mul_scalar(1.0 / accumulator.count, accumulator.sum);
+                weight = accumulator.count;
+            } else {
+                u64 pixel_index = (u64)height * cam->image_width + width;
+
+                for (i32 row_s = 0; row_s < params->sqrt_spp; ++row_s) {
+                    for (i32 col_s = 0; col_s < params->sqrt_spp; ++col_s) {
+
+                        // every sample gets its own random stream so the image doesn't depend on the thread schedule
+                        random_seed_sample(pixel_index, (u64)row_s * params->sqrt_spp + col_s);
+                        f64 dx = (col_s + random_unit()) * cam->inv_sqrt_spp;
+                        f64 dy = (row_s + random_unit()) * cam->inv_sqrt_spp;
+                        ray r = generate_ray(cam, width, height, dx, dy);
+                        color c = get_pixel_color(cam, &r, params->depth, params->world);
+                        pixel_color = vec3_add(pixel_color, c);
+                    }
+                }
+
+                pixel_color = vec3_mul_scalar(pixel_sample_scale, pixel_color); // take the average of all samples
+                weight = params->sqrt_spp * params->sqrt_spp;
+                samples += weight;
+            }
+            f32* pixel = zimage_pixel(&cam->framebuffer, width, height);
+            pixel[0] = (f32)pixel_color.x;
+            pixel[1] = (f32)pixel_color.y;
+            pixel[2] = (f32)pixel_color.z;
+            if (params->weights) {
+                params->weights[(u64)height * cam->image_width + width] = weight;
+            }
+        }
+    }
+    return samples;
+}
+
+/**
+ * @brief takes the pixel's samples from accumulator->count up to sample_end, the running mean and variance of
+ * the sample luminance are kept with welford's update, with adaptive sampling the samples are taken in batches
+ * of adaptive_min_samples and the pixel stops (converged) once the confidence interval of the mean is narrow enough
+ * (flat background stops after the first batch, noisy caustics go to the max)
+ *
+ * @return number of samples taken
+ */
+i32 render_pixel_samples(camera_thread_params* params, i32 width, i32 height, pixel_accumulator* accumulator, i32 sample_end) {
+    camera* cam = params->cam;
+    if (accumulator->converged) {
+        return 0;
+    }
+    u64 pixel_index = (u64)height * cam->image_width + width;
+    i32 first = accumulator->count;
+    // the sample count isn't known up front so the samples can't be put in a grid of strata, the R2 sequence
+    // (randomly shifted per pixel) spreads any number of first samples evenly over the pixel instead
+    random_seed_sample(pixel_index, ADAPTIVE_SHIFT_INDEX);
+    f64 shift_x = random_unit();
+    f64 shift_y = random_unit();
+    i32 batch = cam->adaptive_min_samples ? cam->adaptive_min_samples : sample_end;
+    while (accumulator->count < sample_end) {
+        // batches end on multiples of the batch size, a pass that ends inside a batch leaves it for the next pass
+        i32 batch_end = MIN((accumulator->count / batch + 1) * batch, sample_end);
+        while (accumulator->count < batch_end) {
+            i32 index = accumulator->count;
+            random_seed_sample(pixel_index, (u64)index);
+            f64 dx = shift_x + index * R2_STEP_X;
+            f64 dy = shift_y + index * R2_STEP_Y;
+            ray r = generate_ray(cam, width, height, dx - zfloor(dx), dy - zfloor(dy));
+            color c = get_pixel_color(cam, &r, params->depth, params->world);
+            accumulator->sum = vec3_add(accumulator->sum, c);
+            accumulator->count = index + 1;
+            f64 luminance = 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z;
+            f64 delta = luminance - accumulator->mean;
+            accumulator->mean += delta / accumulator->count;
+            accumulator->m2 += delta * (luminance - accumulator->mean);
+        }
+        // only full batches (or the max) are tested, so the passes of a progressive render stop a pixel
+        // at the same sample as a render in one pass
+        if (!cam->adaptive_min_samples || accumulator->count < cam->adaptive_min_samples ||
+            (accumulator->count % cam->adaptive_min_samples != 0 && accumulator->count != params->max_samples)) {
+            continue;
+        }
+        f64 standard_error = zsqrt(accumulator->m2 / ((f64)(accumulator->count - 1) * accumulator->count));
+        if (ADAPTIVE_CONFIDENCE_SCALE * standard_error <= cam->adaptive_error * MAX(accumulator->mean, ADAPTIVE_LUMINANCE_FLOOR)) {
+            accumulator->converged = true;
+            break;
+        }
+    }
+    return accumulator->count - first;
+}
+
+/// renders every tile once with the current shared params, false if the threads couldn't be run
+bool camera_render_pass(camera* cam, camera_thread_params* shared) {
+#ifndef MULTITHREADING
+    // using single thread
+    camera_render_job(shared);
+#else
+    // using multithread
+    zthread_wait_group group;
+    if (!zthread_wait_group_create(&group)) {
+        LOGE("camera_render_pass: failed to create wait group");
+        return false;
+    }
+    // one job per worker, each job keeps pulling tiles until none are left
+    u32 thread_count = zthread_pool_thread_count(&cam->pool);
+    for (u32 i = 0; i < thread_count; ++i) {
+        zthread_pool_submit(&cam->pool, camera_render_job, shared, &group);
     }
-    color attenuation = {0};
-    ray scattered = {0};
-    color color_from_emmision = record.mat->emitted(record.mat, &record);
-    if (!record.mat->scatter(record.mat, r, &record, &attenuation, &scattered)) {
-        return color_from_emmision;
+    if (!zthread_pool_wait(&cam->pool, &group)) {
+        LOGE("camera_render_pass: threads wait failed");
     }
-    vec3 color_from_scatter = vec3_mul(attenuation, get_pixel_color(cam, &scattered, depth - 1, world));
-    return vec3_add(color_from_emmision, color_from_scatter);
+    zthread_wait_group_destroy(&group);
+#endif
+    return true;
 }
 
-zthread_func_return_type camera_thread_start_func(void* params) {
+void camera_render_job(void* params) {
     camera_thread_params* parameters = (camera_thread_params*)params;
 
-    u64 offset = 0;
-    f64 pixel_sample_scale = 1.0f / (parameters->sqrt_spp * parameters->sqrt_spp);
+    i32 job;
+    while ((job = zatomic_fetch_add_i32(parameters->next_tile, 1)) < parameters->tile_count) {
+        i32 tile = parameters->shard_index + job * parameters->shard_count;
+        i64 samples = render_tile(parameters, tile);
+        zatomic_fetch_add_i64(parameters->samples_done, samples);
+        i32 done = zatomic_fetch_add_i32(parameters->tiles_done, 1) + 1;
+        LOG_STDOUT("\rremaning tiles %d                      ", parameters->tile_count - done);
+    }
+}
 
-    for (i32 height = parameters->height_start; height < parameters->height_end; ++height) {
+void camera_write_snapshot(camera* cam, const char* file_path) {
+    // written next to the snapshot and moved over it, so a viewer never reads a half written image
+    char temp_path[MAX_PATH_LENGTH];
+    char snapshot_path[MAX_PATH_LENGTH];
+    if (!camera_output_path(temp_path, file_path, SNAPSHOT_TEMP_EXTENSION) ||
+        !camera_output_path(snapshot_path, file_path, SNAPSHOT_EXTENSION)) {
+        return;
+    }
+    if (zimage_write_ppm(&cam->framebuffer, temp_path)) {
+        platform_file_replace(temp_path, snapshot_path);
+    }
+}
 
-        for (i32 width = 0; width < parameters->width; ++width) {
-            color pixel_color = {0.0, 0.0, 0.0};
+bool camera_write_checkpoint(camera* cam, const char* file_path, checkpoint_header* header, pixel_accumulator* accumulators) {
+    // written next to the checkpoint and moved over it, a crash while writing keeps the previous one
+    char temp_path[MAX_PATH_LENGTH];
+    char checkpoint_path[MAX_PATH_LENGTH];
+    if (!camera_checkpoint_path(cam, temp_path, file_path, true) ||
+        !camera_checkpoint_path(cam, checkpoint_path, file_path, false)) {
+        return false;
+    }
+    FILE* file = file_open(temp_path, true, FILE_MODE_WRITE);
+    if (file == 0) {
+        LOGE("camera_write_checkpoint: failed to open %s", temp_path);
+        return false;
+    }
+    u64 pixel_count = (u64)cam->image_width * cam->image_height;
+    bool result = file_write(header, sizeof(checkpoint_header), 1, file) == 1 &&
+                  file_write(accumulators, sizeof(pixel_accumulator), pixel_count, file) == pixel_count;
+    file_close(file);
+    if (!result) {
+        LOGE("camera_write_checkpoint: failed to write %s", temp_path);
+        return false;
+    }
+    return platform_file_replace(temp_path, checkpoint_path);
+}
 
-            for (i32 row_s = 0; row_s < parameters->sqrt_spp; ++row_s) {
-                for (i32 col_s = 0; col_s < parameters->sqrt_spp; ++col_s) {
+/**
+ * @brief loads the checkpoint of file_path if it was written by the same render (image size, view, depth and
+ * sampling settings, the scene itself can't be checked), header gets its seed and sample_end
+ */
+bool camera_read_checkpoint(camera* cam, const char* file_path, checkpoint_header* header, pixel_accumulator* accumulators) {
+    char checkpoint_path[MAX_PATH_LENGTH];
+    if (!camera_checkpoint_path(cam, checkpoint_path, file_path, false)) {
+        return false;
+    }
+    FILE* file = file_open(checkpoint_path, true, FILE_MODE_READ);
+    if (file == 0) {
+        LOGW("camera_read_checkpoint: no checkpoint %s, starting from 0 samples", checkpoint_path);
+        return false;
+    }
+    checkpoint_header saved;
+    bool result = file_read(&saved, sizeof(checkpoint_header), 1, file) == 1;
+    if (result && (saved.magic != header->magic || saved.version != header->version ||
+                   saved.accumulator_size != header->accumulator_size ||
+                   saved.image_width != header->image_width || saved.image_height != header->image_height ||
+                   saved.depth != header->depth || saved.adaptive_min_samples != header->adaptive_min_samples ||
+                   saved.shard_index != header->shard_index || saved.shard_count != header->shard_count ||
+                   saved.adaptive_error != header->adaptive_error || saved.field_of_view != header->field_of_view ||
+                   !vec3_compare(saved.look_from, header->look_from) || !vec3_compare(saved.look_at, header->look_at) ||
+                   !vec3_compare(saved.world_up, header->world_up))) {
+        LOGE("camera_read_checkpoint: %s belongs to a different render, starting from 0 samples", checkpoint_path);
+        file_close(file);
+        return false;
+    }
+    u64 pixel_count = (u64)cam->image_width * cam->image_height;
+    result = result && file_read(accumulators, sizeof(pixel_accumulator), pixel_count, file) == pixel_count;
+    file_close(file);
+    if (!result) {
+        LOGE("camera_read_checkpoint: %s is truncated, starting from 0 samples", checkpoint_path);
+        zmemory_set_zero(accumulators, pixel_count * sizeof(pixel_accumulator));
+        return false;
+    }
+    *header = saved;
+    return true;
+}
+
+void camera_resolve(camera* cam, pixel_accumulator* accumulators) {
+    for (i32 height = 0; height < cam->image_height; ++height) {
+        for (i32 width = 0; width < cam->image_width; ++width) {
+            pixel_accumulator* accumulator = &accumulators[(u64)height * cam->image_width + width];
+            color pixel_color = vec3_mul_scalar(1.0 / MAX(accumulator->count, 1), accumulator->sum);
+            f32* pixel = zimage_pixel(&cam->framebuffer, width, height);
+            pixel[0] = (f32)pixel_color.x;
+            pixel[1] = (f32)pixel_color.y;
+            pixel[2] = (f32)pixel_color.z;
+        }
+    }
+}
+
+/// mean over the pixels of the 95% confidence interval of the luminance relative to the mean (what adaptive sampling tests)
+f64 camera_error_estimate(camera* cam, pixel_accumulator* accumulators) {
+    u64 pixel_count = (u64)cam->image_width * cam->image_height;
+    f64 error_sum = 0.0;
+    u64 rendered_count = 0;
+    for (u64 i = 0; i < pixel_count; ++i) {
+        pixel_accumulator* accumulator = &accumulators[i];
+        if (accumulator->count == 0) {
+            continue; // another shard's pixel
+        }
+        ++rendered_count;
+        if (accumulator->count < 2) {
+            error_sum += 1.0; // no variance yet, count it as fully unknown
+            continue;
+        }
+        f64 standard_error = zsqrt(accumulator->m2 / ((f64)(accumulator->count - 1) * accumulator->count));
+        error_sum += ADAPTIVE_CONFIDENCE_SCALE * standard_error / MAX(accumulator->mean, ADAPTIVE_LUMINANCE_FLOOR);
+    }
+    return error_sum / MAX(rendered_count, 1);
+}
+
+/// every shard keeps its own checkpoint, they can all be written next to each other on a shared file system
+bool camera_checkpoint_path(camera* cam, char* out_path, const char* file_path, bool temp) {
+    if (!cam->shard_count) {
+        return camera_output_path(out_path, file_path, temp ? CHECKPOINT_TEMP_EXTENSION : CHECKPOINT_EXTENSION);
+    }
+    char extension[MAX_EXTENSION_LENGTH];
+    LOG_BUFFER(extension, MAX_EXTENSION_LENGTH, temp ? SHARD_CHECKPOINT_TEMP_EXTENSION : SHARD_CHECKPOINT_EXTENSION, cam->shard_index);
+    return camera_output_path(out_path, file_path, extension);
+}
+
+bool camera_shard_path(char* out_path, const char* file_path, i32 shard_index, bool temp) {
+    char extension[MAX_EXTENSION_LENGTH];
+    LOG_BUFFER(extension, MAX_EXTENSION_LENGTH, temp ? SHARD_TEMP_EXTENSION : SHARD_EXTENSION, shard_index);
+    return camera_output_path(out_path, file_path, extension);
+}
 
-                    ray r = generate_ray(parameters->cam, width, height, row_s, col_s);
-                    color c = get_pixel_color(parameters->cam, &r, parameters->depth, parameters->world);
-                    pixel_color = vec3_add(pixel_color, c);
+/**
+ * @brief the image pixels of the shard's tiles in the order the shard file stores them, tile by tile and row by row
+ * inside a tile, out_indices can be 0 to only count them
+ *
+ * @return number of pixels
+ */
+u64 camera_shard_pixels(i32 width, i32 height, i32 tile_size, i32 shard_index, i32 shard_count, u64* out_indices) {
+    i32 tiles_per_row = (width + tile_size - 1) / tile_size;
+    i32 tile_count = tiles_per_row * ((height + tile_size - 1) / tile_size);
+    u64 count = 0;
+    for (i32 tile = shard_index; tile < tile_count; tile += shard_count) {
+        i32 width_start = (tile % tiles_per_row) * tile_size;
+        i32 height_start = (tile / tiles_per_row) * tile_size;
+        i32 width_end = MIN(width_start + tile_size, width);
+        i32 height_end = MIN(height_start + tile_size, height);
+        for (i32 y = height_start; y < height_end; ++y) {
+            for (i32 x = width_start; x < width_end; ++x) {
+                if (out_indices) {
+                    out_indices[count] = (u64)y * width + x;
                 }
+                ++count;
             }
+        }
+    }
+    return count;
+}
 
-            pixel_color = vec3_mul_scalar(pixel_sample_scale, pixel_color); // take the average of all samples
-            pixel_color.x = zpow(pixel_color.x, GAMMA);
-            pixel_color.y = zpow(pixel_color.y, GAMMA);
-            pixel_color.z = zpow(pixel_color.z, GAMMA);
-            i32 r = (i32)(255.9999 * pixel_color.x);
-            i32 g = (i32)(255.9999 * pixel_color.y);
-            i32 b = (i32)(255.9999 * pixel_color.z);
-            offset += LOG_BUFFER(parameters->buffer + offset, parameters->buffer_size - offset, "%d %d %d\n", r, g, b);
+bool camera_write_shard(camera* cam, const char* file_path, u64 seed, i32* weights) {
+    // written next to the shard and moved over it, the merge never reads a half written shard
+    char temp_path[MAX_PATH_LENGTH];
+    char shard_path[MAX_PATH_LENGTH];
+    if (!camera_shard_path(temp_path, file_path, cam->shard_index, true) ||
+        !camera_shard_path(shard_path, file_path, cam->shard_index, false)) {
+        return false;
+    }
+    // only the shard's own tiles are written, the other shards have the rest of the image
+    u64 pixel_count = camera_shard_pixels(cam->image_width, cam->image_height, cam->tile_size, cam->shard_index, cam->shard_count, 0);
+    shard_pixel* pixels = 0;
+    u64* indices = 0;
+    if (pixel_count) {
+        pixels = zmemory_allocate(pixel_count * sizeof(shard_pixel));
+        indices = zmemory_allocate(pixel_count * sizeof(u64));
+        camera_shard_pixels(cam->image_width, cam->image_height, cam->tile_size, cam->shard_index, cam->shard_count, indices);
+        for (u64 i = 0; i < pixel_count; ++i) {
+            u64 index = indices[i];
+            pixels[i].value[0] = cam->framebuffer.pixels[index * 3 + 0];
+            pixels[i].value[1] = cam->framebuffer.pixels[index * 3 + 1];
+            pixels[i].value[2] = cam->framebuffer.pixels[index * 3 + 2];
+            pixels[i].weight = weights[index];
         }
     }
-    return 0;
+    shard_header header = {
+        .magic = SHARD_MAGIC,
+        .version = SHARD_VERSION,
+        .pixel_size = sizeof(shard_pixel),
+        .image_width = cam->image_width,
+        .image_height = cam->image_height,
+        .tile_size = cam->tile_size,
+        .shard_index = cam->shard_index,
+        .shard_count = cam->shard_count,
+        .pixel_count = pixel_count,
+        .seed = seed,
+    };
+    bool result = false;
+    FILE* file = file_open(temp_path, true, FILE_MODE_WRITE);
+    if (file == 0) {
+        LOGE("camera_write_shard: failed to open %s", temp_path);
+    } else {
+        result = file_write(&header, sizeof(shard_header), 1, file) == 1 &&
+                 (pixel_count == 0 || file_write(pixels, sizeof(shard_pixel), pixel_count, file) == pixel_count);
+        file_close(file);
+        if (!result) {
+            LOGE("camera_write_shard: failed to write %s", temp_path);
+        }
+    }
+    if (pixel_count) {
+        zmemory_free(pixels, pixel_count * sizeof(shard_pixel));
+        zmemory_free(indices, pixel_count * sizeof(u64));
+    }
+    return result && platform_file_replace(temp_path, shard_path);
+}
+
+bool camera_merge_shards(const char* file_path, i32 shard_count) {
+    if (file_path == 0 || shard_count <= 0) {
+        LOGE("camera_merge_shards: invalid params");
+        return false;
+    }
+    zimage image = {0};
+    bool* rendered = 0;
+    shard_pixel* pixels = 0; // a shard never has more pixels than the image
+    u64* indices = 0;
+    u64 pixel_count = 0;
+    i32 tile_size = 0;
+    u64 seed = 0;
+    bool result = true;
+    for (i32 shard = 0; result && shard < shard_count; ++shard) {
+        char shard_path[MAX_PATH_LENGTH];
+        if (!camera_shard_path(shard_path, file_path, shard, false)) {
+            result = false;
+            break;
+        }
+        FILE* file = file_open(shard_path, true, FILE_MODE_READ);
+        if (file == 0) {
+            LOGE("camera_merge_shards: missing shard %s", shard_path);
+            result = false;
+            break;
+        }
+        shard_header header;
+        if (file_read(&header, sizeof(shard_header), 1, file) != 1 || header.magic != SHARD_MAGIC ||
+            header.version != SHARD_VERSION || header.pixel_size != sizeof(shard_pixel) ||
+            header.shard_index != shard || header.shard_count != shard_count || header.tile_size <= 0 ||
+            header.pixel_count != camera_shard_pixels(header.image_width, header.image_height, header.tile_size, shard, shard_count, 0) ||
+            (shard > 0 && (header.image_width != image.width || header.image_height != image.height || header.tile_size != tile_size))) {
+            LOGE("camera_merge_shards: %s is not shard %d/%d of the image", shard_path, shard, shard_count);
+            file_close(file);
+            result = false;
+            break;
+        }
+        if (shard == 0) {
+            if (!zimage_create(header.image_width, header.image_height, &image)) {
+                file_close(file);
+                result = false;
+                break;
+            }
+            pixel_count = (u64)image.width * image.height;
+            rendered = zmemory_allocate(pixel_count * sizeof(bool));
+            pixels = zmemory_allocate(pixel_count * sizeof(shard_pixel));
+            indices = zmemory_allocate(pixel_count * sizeof(u64));
+            tile_size = header.tile_size;
+            seed = header.seed;
+        } else if (header.seed != seed) {
+            LOGW("camera_merge_shards: %s has another random seed, the image won't match a single process render", shard_path);
+        }
+        u64 shard_pixel_count = header.pixel_count;
+        result = shard_pixel_count == 0 || file_read(pixels, sizeof(shard_pixel), shard_pixel_count, file) == shard_pixel_count;
+        file_close(file);
+        if (!result) {
+            LOGE("camera_merge_shards: %s is truncated", shard_path);
+            break;
+        }
+        camera_shard_pixels(image.width, image.height, tile_size, shard, shard_count, indices);
+        for (u64 j = 0; j < shard_pixel_count; ++j) {
+            shard_pixel* in = &pixels[j];
+            if (in->weight <= 0) {
+                continue;
+            }
+            // the shards own disjoint tiles, every pixel is copied as is, bit exact with the single process render
+            u64 i = indices[j];
+            image.pixels[i * 3 + 0] = in->value[0];
+            image.pixels[i * 3 + 1] = in->value[1];
+            image.pixels[i * 3 + 2] = in->value[2];
+            rendered[i] = true;
+        }
+    }
+    if (result) {
+        u64 missing = 0;
+        for (u64 i = 0; i < pixel_count; ++i) {
+            missing += !rendered[i];
+        }
+        if (missing) {
+            LOGW("camera_merge_shards: %llu pixels weren't rendered by any shard", missing);
+        }
+        camera_write_image(&image, file_path);
+        LOGI("merged %d shards into %s", shard_count, file_path);
+    }
+    if (image.pixels) {
+        zimage_destroy(&image);
+        zmemory_free(rendered, pixel_count * sizeof(bool));
+        zmemory_free(pixels, pixel_count * sizeof(shard_pixel));
+        zmemory_free(indices, pixel_count * sizeof(u64));
+    }
+    return result;
+}
+
+void camera_write_image(zimage* image, const char* file_path) {
+    char path[MAX_PATH_LENGTH];
+    if (camera_output_path(path, file_path, "ppm")) {
+        zimage_write_ppm(image, path);
+    }
+#ifdef BMP
+    if (camera_output_path(path, file_path, "bmp")) {
+        zimage_write_bmp(image, path);
+    }
+#endif
+#ifdef PFM
+    if (camera_output_path(path, file_path, "pfm")) {
+        zimage_write_pfm(image, path);
+    }
+#endif
+}
+
+bool camera_output_path(char* out_path, const char* file_path, const char* extension) {
+    // replace the extension of the file name (if any) with the given one
+    i32 length = 0;
+    i32 dot = -1;
+    for (; file_path[length] != '\0'; ++length) {
+        if (file_path[length] == '.') {
+            dot = length;
+        } else if (file_path[length] == '/' || file_path[length] == '\\') {
+            dot = -1;
+        }
+    }
+    i32 stem = dot < 0 ? length : dot;
+    i32 written = LOG_BUFFER(out_path, MAX_PATH_LENGTH, "%.*s.%s", stem, file_path, extension);
+    if (written >= MAX_PATH_LENGTH) {
+        LOGE("camera_output_path: file path too long");
+        return false;
+    }
+    return true;
 }
@@ -8,10 +8,85 @@ typedef struct camera camera;
 typedef struct hittable_list hittable_list;
 typedef struct ray ray;
 
+/**
+ * @brief render settings from the command line, every camera created after camera_set_default_options
+ * starts with them (the camera_set_* functions still change a single camera)
+ */
+typedef struct camera_options {
+    i32 samples_per_pass;    /// --passes <n>, see camera_set_progressive
+    f64 checkpoint_interval; /// --checkpoint <seconds>, see camera_set_checkpoint
+    bool resume;             /// --resume, see camera_set_checkpoint
+    f64 time_budget;         /// --time <seconds>, see camera_set_time_budget
+    i32 shard_index;         /// --shard <index>/<count>, see camera_set_shard
+    i32 shard_count;
+} camera_options;
+
+void camera_set_default_options(const camera_options* options);
+
 camera* camera_create(i32 image_width, i32 image_height);
 
 void camera_destroy(camera* cam);
 
+/// size in pixels of the square tiles the image is split into while rendering (default 16)
+void camera_set_tile_size(camera* cam, i32 tile_size);
+
+/**
+ * @brief adaptive sampling: every pixel starts with a batch of min_samples and gets more batches until the
+ * 95% confidence interval of its mean luminance is within relative_error of the mean, or it reached the
+ * samples_per_pixel given to camera_render (then the max), relative_error 0 turns it off (default)
+ * small batches (< 32) can stop too early on pixels where a few rare paths carry most of the light
+ */
+void camera_set_adaptive_sampling(camera* cam, i32 min_samples, f64 relative_error);
+
+/**
+ * @brief progressive rendering: the image is rendered in passes of samples_per_pass samples per pixel into a
+ * float accumulation buffer, after every pass <file_path>.partial.ppm is replaced with the image so far
+ * (removed once the final image is written), 0 renders in one pass (default)
+ * adaptive sampling only tests whole batches, so passes that don't line up with them give the same image as one pass
+ */
+void camera_set_progressive(camera* cam, i32 samples_per_pass);
+
+/**
+ * @brief checkpoints: the per pixel sums and sample counts, the random seed and the render settings are written to
+ * <file_path>.checkpoint after a pass once interval_seconds went by since the last one, and after the last pass
+ * (a render that doesn't use passes is split in passes of 16 samples), an interval of 0 writes only the last one
+ * with resume the render continues from that checkpoint, giving the same image as an uninterrupted render,
+ * a finished render resumed with a higher samples_per_pixel only takes the extra samples
+ */
+void camera_set_checkpoint(camera* cam, f64 interval_seconds, bool resume);
+
+/**
+ * @brief time budgeted rendering: camera_render renders progressive passes until samples_per_pixel or until the next
+ * pass wouldn't fit in the seconds left, a pilot pass of 1 sample per pixel measures the cost of a sample and every
+ * pass updates it, the spp reached and the remaining error estimate are logged, 0 turns it off (default)
+ * with adaptive sampling the pilot is rounded up to a whole batch of min_samples and the passes down to whole batches,
+ * the render ends when not even one batch fits
+ */
+void camera_set_time_budget(camera* cam, f64 seconds);
+
+/**
+ * @brief sharded rendering: the image is split between shard_count processes (or machines sharing a file system),
+ * this one renders only every shard_count-th tile starting at shard_index and writes its pixels with their sample
+ * counts to <file_path>.shard<shard_index> instead of the image, checkpoints go to <file_path>.shard<shard_index>.checkpoint
+ * the pixels are rendered exactly like in a single process render, 0 renders the whole image (default)
+ * a shard file holds only the shard's own tiles, so all the shards of an image together take about one image on disk
+ */
+void camera_set_shard(camera* cam, i32 shard_index, i32 shard_count);
+
+/**
+ * @brief combines <file_path>.shard0 ... <file_path>.shard<shard_count - 1> into the image files of file_path,
+ * with the same seed the image is bit exact with a single process render
+ *
+ * @return false if a shard is missing, truncated or belongs to another image
+ */
+bool camera_merge_shards(const char* file_path, i32 shard_count);
+
+/**
+ * @brief renders world into <file_path>.ppm (and .bmp/.pfm when built with them)
+ * a one pass render without adaptive sampling stratifies the samples in a grid, so samples_per_pixel is truncated
+ * to the nearest lower square (200 renders 14x14 = 196), progressive, checkpointed, budgeted and adaptive renders
+ * take exactly samples_per_pixel (a sharded render takes the same samples as the single process render it splits)
+ */
 void camera_render(camera* cam, hittable_list* world, const char* file_path,
                    f64 viewport_field_of_view, point3 look_from, point3 look_at, vec3 world_up,
                    i32 samples_per_pixel, i32 depth, color (*background)(ray* r_in));
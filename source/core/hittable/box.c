@@ -1,7 +1,5 @@
 #include "box.h"
-#include "darray.h"
 #include "zmemory.h"
-#include "bvh.h"
 #include "logger.h"
 
 ////////////////////////////////////
@@ -24,39 +22,14 @@ box* box_create(point3 point1, point3 point2, material* mat) {
         return 0;
     }
 
-    aabb bounds = aabb_create(point1, point2);
-    vec3 dx = (vec3){bounds.x_range.max - bounds.x_range.min, 0, 0};
-    vec3 dy = (vec3){0, bounds.y_range.max - bounds.y_range.min, 0};
-    vec3 dz = (vec3){0, 0, bounds.z_range.max - bounds.z_range.min};
-
     box* temp = zmemory_allocate(sizeof(box));
-    temp->base.box = bounds;
+    temp->base.box = aabb_create(point1, point2);
     temp->base.hit = box_hit;
-    temp->front = zmemory_allocate(sizeof(quad));
-    temp->back = zmemory_allocate(sizeof(quad));
-    temp->left = zmemory_allocate(sizeof(quad));
-    temp->right = zmemory_allocate(sizeof(quad));
-    temp->top = zmemory_allocate(sizeof(quad));
-    temp->bottom = zmemory_allocate(sizeof(quad));
-    temp->darray = darray_create(hittable*);
-
-    /// get the faces of box
-    *(temp->front) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.max}, dx, dy, mat);
-    *(temp->back) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dx, dy, mat);
-    *(temp->left) = quad_create((point3){bounds.x_range.max, bounds.y_range.min, bounds.z_range.min}, dz, dy, mat);
-    *(temp->right) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dz, dy, mat);
-    *(temp->top) = quad_create((point3){bounds.x_range.min, bounds.y_range.max, bounds.z_range.min}, dz, dx, mat);
-    *(temp->bottom) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dz, dx, mat);
-
-    temp->darray = _darray_push_back(temp->darray, &temp->front);
-    temp->darray = _darray_push_back(temp->darray, &temp->back);
-    temp->darray = _darray_push_back(temp->darray, &temp->left);
-    temp->darray = _darray_push_back(temp->darray, &temp->right);
-    temp->darray = _darray_push_back(temp->darray, &temp->top);
-    temp->darray = _darray_push_back(temp->darray, &temp->bottom);
-
-    temp->bvh = bvh_create(temp->darray);
-
+    temp->base.surface = box_surface;
+    temp->base.occluded = primitive_occluded;
+    for (i32 i = 0; i < BOX_FACE_COUNT; ++i) {
+        temp->mats[i] = mat;
+    }
     return temp;
 }
 
@@ -71,53 +44,93 @@ box* box_create_different_material(point3 point1, point3 point2,
         return 0;
     }
 
-    aabb bounds = aabb_create(point1, point2);
-    vec3 dx = (vec3){bounds.x_range.max - bounds.x_range.min, 0, 0};
-    vec3 dy = (vec3){0, bounds.y_range.max - bounds.y_range.min, 0};
-    vec3 dz = (vec3){0, 0, bounds.z_range.max - bounds.z_range.min};
-
     box* temp = zmemory_allocate(sizeof(box));
-    temp->base.box = bounds;
+    temp->base.box = aabb_create(point1, point2);
     temp->base.hit = box_hit;
-    temp->front = zmemory_allocate(sizeof(quad));
-    temp->back = zmemory_allocate(sizeof(quad));
-    temp->left = zmemory_allocate(sizeof(quad));
-    temp->right = zmemory_allocate(sizeof(quad));
-    temp->top = zmemory_allocate(sizeof(quad));
-    temp->bottom = zmemory_allocate(sizeof(quad));
-    temp->darray = darray_create(hittable*);
+    temp->base.surface = box_surface;
+    temp->base.occluded = primitive_occluded;
+    temp->mats[BOX_FACE_RIGHT] = right;
+    temp->mats[BOX_FACE_LEFT] = left;
+    temp->mats[BOX_FACE_BOTTOM] = bottom;
+    temp->mats[BOX_FACE_TOP] = top;
+    temp->mats[BOX_FACE_BACK] = back;
+    temp->mats[BOX_FACE_FRONT] = front;
+    return temp;
+}
 
-    /// get the faces of box
-    *(temp->front) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.max}, dx, dy, front);
-    *(temp->back) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dx, dy, back);
-    *(temp->left) = quad_create((point3){bounds.x_range.max, bounds.y_range.min, bounds.z_range.min}, dz, dy, left);
-    *(temp->right) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dz, dy, right);
-    *(temp->top) = quad_create((point3){bounds.x_range.min, bounds.y_range.max, bounds.z_range.min}, dz, dx, top);
-    *(temp->bottom) = quad_create((point3){bounds.x_range.min, bounds.y_range.min, bounds.z_range.min}, dz, dx, bottom);
+bool box_hit(hittable* box_object, ray* r_in, interval r_t, hit_record* out_record) {
+    box* b = (box*)box_object;
+    const interval* ranges = &b->base.box.x_range;
+    const f64* origin = &r_in->origin.x;
+    const f64* inv_direction = &r_in->inv_direction.x;
+
+    /**
+     * @brief the ray enters the box at the last of the 3 slab entries and leaves it at the first slab exit
+     * a ray parallel to a slab gets -inf/+inf (or NaN on the slab plane, which never wins a comparison)
+     */
+    f64 t_enter = -INFINITY;
+    f64 t_exit = INFINITY;
+    i32 enter_axis = 0;
+    i32 exit_axis = 0;
+    for (i32 axis = 0; axis < 3; ++axis) {
+        f64 t_near = ((r_in->sign[axis] ? ranges[axis].max : ranges[axis].min) - origin[axis]) * inv_direction[axis];
+        f64 t_far = ((r_in->sign[axis] ? ranges[axis].min : ranges[axis].max) - origin[axis]) * inv_direction[axis];
+        if (t_near > t_enter) {
+            t_enter = t_near;
+            enter_axis = axis;
+        }
+        if (t_far < t_exit) {
+            t_exit = t_far;
+            exit_axis = axis;
+        }
+    }
+    if (t_enter > t_exit) {
+        return false;
+    }
 
-    temp->darray = _darray_push_back(temp->darray, &temp->front);
-    temp->darray = _darray_push_back(temp->darray, &temp->back);
-    temp->darray = _darray_push_back(temp->darray, &temp->left);
-    temp->darray = _darray_push_back(temp->darray, &temp->right);
-    temp->darray = _darray_push_back(temp->darray, &temp->top);
-    temp->darray = _darray_push_back(temp->darray, &temp->bottom);
+    /// the entry face when it is in front of the ray, the exit face when the ray starts inside
+    f64 t;
+    i32 face;
+    if (interval_surrounds(r_t, t_enter)) {
+        t = t_enter;
+        face = 2 * enter_axis + r_in->sign[enter_axis];
+    } else if (t_enter <= r_t.min && interval_surrounds(r_t, t_exit)) {
+        t = t_exit;
+        face = 2 * exit_axis + 1 - r_in->sign[exit_axis];
+    } else {
+        return false;
+    }
 
-    temp->bvh = bvh_create(temp->darray);
+    hit_record_set_hit(out_record, box_object, t);
+    out_record->primitive_id = face;
+    return true;
+}
 
-    return temp;
+void box_surface(hittable* box_object, ray* r_in, hit_record* record) {
+    box* b = (box*)box_object;
+    const interval* ranges = &b->base.box.x_range;
+    i32 face = record->primitive_id;
+    i32 axis = face / 2;
+    point3 point = ray_at(r_in, record->t);
+    f64* coords = &point.x;
+    coords[axis] = (face & 1) ? ranges[axis].max : ranges[axis].min; // exactly on the face
+    vec3 outward_normal = vec3_zero();
+    (&outward_normal.x)[axis] = (face & 1) ? 1.0 : -1.0;
+
+    /// same texture axes as the quads the faces used to be: x faces (z,y), y faces (z,x), z faces (x,y)
+    i32 u_axis = axis == 2 ? 0 : 2;
+    i32 v_axis = axis == 1 ? 0 : 1;
+    record->point = point;
+    record->mat = b->mats[face];
+    record->u = (coords[u_axis] - ranges[u_axis].min) / (ranges[u_axis].max - ranges[u_axis].min);
+    record->v = (coords[v_axis] - ranges[v_axis].min) / (ranges[v_axis].max - ranges[v_axis].min);
+    hit_record_set_face_normal(record, r_in, outward_normal);
 }
 
 void box_destroy(box* box_object) {
     if (box_object == 0) {
         LOGE("box_destroy: invalid params");
+        return;
     }
-    bvh_destroy(box_object->bvh);
-    darray_destroy(box_object->darray);
-    zmemory_free(box_object->front, sizeof(quad));
-    zmemory_free(box_object->back, sizeof(quad));
-    zmemory_free(box_object->left, sizeof(quad));
-    zmemory_free(box_object->right, sizeof(quad));
-    zmemory_free(box_object->top, sizeof(quad));
-    zmemory_free(box_object->bottom, sizeof(quad));
     zmemory_free(box_object, sizeof(box));
-}
\ No newline at end of file
+}
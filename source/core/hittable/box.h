@@ -4,20 +4,25 @@
 #include "hittable.h"
 
 /**
- * @brief box is a derived struct from base hittable which contains bvh which has all the sides
+ * @brief box is a derived struct from base hittable, an axis aligned box (rotate it with a transform)
+ * the bounds are the box itself and the ray is clipped against the 3 slabs in one pass,
+ * the material is picked by the face that was hit
  *
  */
 
+typedef enum box_face {
+    BOX_FACE_RIGHT,  /// -x
+    BOX_FACE_LEFT,   /// +x
+    BOX_FACE_BOTTOM, /// -y
+    BOX_FACE_TOP,    /// +y
+    BOX_FACE_BACK,   /// -z
+    BOX_FACE_FRONT,  /// +z
+    BOX_FACE_COUNT,
+} box_face;
+
 typedef struct box {
     hittable base;
-    quad* front;
-    quad* back;
-    quad* left;
-    quad* right;
-    quad* top;
-    quad* bottom;
-    hittable** darray;
-    hittable* bvh;
+    material* mats[BOX_FACE_COUNT]; /// indexed by box_face (2 * axis + 1 for the max side)
 } box;
 
 /**
@@ -29,17 +34,13 @@ typedef struct box {
  * @param out_record details like point, t,normal,u,v, are written into record
  * @return bool
  */
-INLINE bool box_hit(hittable* box_object, ray* r_in, interval r_t, hit_record* out_record) {
-    box* b = (box*)box_object;
-    if (b->bvh->hit(b->bvh, r_in, r_t, out_record)) {
-        return true;
-    }
-    return false;
-}
+bool box_hit(hittable* box_object, ray* r_in, interval r_t, hit_record* out_record);
+
+void box_surface(hittable* box_object, ray* r_in, hit_record* record);
 
 /**
  * @brief box_create will create box based on the diagnoal points provided
- * it will create box with all sides included into a bvh
+ * all the faces share the material
  *
  * @param point1 diagnoal point of box
  * @param point2 opposite diagnoal point of point1
@@ -50,7 +51,7 @@ box* box_create(point3 point1, point3 point2, material* mat);
 
 /**
  * @brief box_create will create box based on the diagnoal points provided and materials
- * it will create box with all sides included into a bvh
+ * every face has its own material
  *
  * @param point1 diagnoal point of box
  * @param point2 opposite diagnoal point of point2
@@ -32,13 +32,32 @@ bool circle_hit(hittable* circle_object, ray* r_in, interval r_t, hit_record* ou
     if (vec3_length_squared(dp) > cir->radius * cir->radius) {
         return false;
     }
-    out_record->t = t;
-    out_record->point = point;
-    out_record->mat = cir->mat;
+    hit_record_set_hit(out_record, circle_object, t);
+    return true;
+}
+
+void circle_surface(hittable* circle_object, ray* r_in, hit_record* record) {
+    circle* cir = (circle*)circle_object;
+    record->point = ray_at(r_in, record->t);
+    record->mat = cir->mat;
     /// bitangent and tangent unit vectors are perpendicular to normal of the circle , these are used to get the u,v texture coordinates for circle
-    out_record->u = NDC_TO_UNIT(vec3_dot(dp, cir->bitangent) / cir->radius);
-    out_record->v = NDC_TO_UNIT(vec3_dot(dp, cir->tangent) / cir->radius);
-    hit_record_set_face_normal(out_record, r_in, cir->normal);
+    vec3 dp = vec3_sub(record->point, cir->center);
+    record->u = NDC_TO_UNIT(vec3_dot(dp, cir->bitangent) / cir->radius);
+    record->v = NDC_TO_UNIT(vec3_dot(dp, cir->tangent) / cir->radius);
+    hit_record_set_face_normal(record, r_in, cir->normal);
+}
 
-    return true;
-}
\ No newline at end of file
+vec3 circle_sample(hittable* circle_object, point3 origin) {
+    circle* cir = (circle*)circle_object;
+    /// sqrt keeps the points uniform over the area instead of bunching them at the center
+    f64 r = cir->radius * zsqrt(random_unit());
+    f64 phi = 2.0 * PI * random_unit();
+    point3 point = vec3_add(cir->center, vec3_add(vec3_mul_scalar(r * zcos(phi), cir->tangent),
+                                                  vec3_mul_scalar(r * zsin(phi), cir->bitangent)));
+    return vec3_sub(point, origin);
+}
+
+f64 circle_pdf(hittable* circle_object, point3 origin, vec3 direction) {
+    circle* cir = (circle*)circle_object;
+    return flat_light_pdf(circle_object, origin, direction, cir->normal, PI * cir->radius * cir->radius);
+}
@@ -6,8 +6,9 @@ bool constant_medium_hit(hittable* object, ray* r_in, interval r_t, hit_record*
      *
      */
     constant_medium* medium = (constant_medium*)object;
-    hit_record rec1 = {0};
-    hit_record rec2 = {0};
+    /// only the t of the boundary hits is needed, their surface is never computed
+    hit_record rec1;
+    hit_record rec2;
     /// this will get the lower t
     if (!medium->object->hit(medium->object, r_in, interval_universe(), &rec1))
         return false;
@@ -33,13 +34,17 @@ bool constant_medium_hit(hittable* object, ray* r_in, interval r_t, hit_record*
     if (hit_distance > distance_inside_boundary)
         return false;
 
-    out_record->t = rec1.t + hit_distance / len;
-    out_record->point = ray_at(r_in, out_record->t);
-    out_record->mat = medium->mat;
-    out_record->u = rec2.u;
-    out_record->v = rec2.v;
-    out_record->normal = rec2.normal;
-    out_record->front_face = true;
-
+    hit_record_set_hit(out_record, object, rec1.t + hit_distance / len);
     return true;
-}
\ No newline at end of file
+}
+
+void constant_medium_surface(hittable* object, ray* r_in, hit_record* record) {
+    constant_medium* medium = (constant_medium*)object;
+    /// the scattering happens inside the volume, there is no surface so the normal and uv are arbitrary
+    record->point = ray_at(r_in, record->t);
+    record->mat = medium->mat;
+    record->u = 0.0;
+    record->v = 0.0;
+    record->normal = (vec3){1.0, 0.0, 0.0};
+    record->front_face = true;
+}
@@ -1,90 +1,101 @@
 #include "hittable.h"
 
-bool cylinder_hit_help(hittable* cylinder_object, ray* r_in, interval r_t, hit_record* out_record);
-
+/**
+ * @brief the solid cylinder is the overlap of the slab between the caps and the infinite cylinder around the axis
+ * both give the ray an [enter, exit] range, the ray is inside the cylinder where they overlap so
+ * it enters at the later of the 2 entries and leaves at the first of the 2 exits,
+ * whichever range gave that t tells if it is a cap or the side
+ */
 bool cylinder_hit(hittable* cylinder_object, ray* r_in, interval r_t, hit_record* out_record) {
-    hit_record temp_record = {0};
-    bool hit_any = 0;
-    f64 closest_so_far = r_t.max;
     cylinder* shape = (cylinder*)cylinder_object;
+    vec3 oc = vec3_sub(r_in->origin, shape->bottom_center);
+    f64 axial_origin = vec3_dot(oc, shape->direction);
+    f64 axial_speed = vec3_dot(r_in->direction, shape->direction);
 
-    // check for top_circle
-    if (shape->top_circle.base.hit((hittable*)(&shape->top_circle), r_in, (interval){r_t.min, closest_so_far}, &temp_record)) {
-        *out_record = temp_record;
-        closest_so_far = temp_record.t;
-        hit_any = 1;
-    }
-    // check for bottom_circle
-    if (shape->bottom_circle.base.hit((hittable*)(&shape->bottom_circle), r_in, (interval){r_t.min, closest_so_far}, &temp_record)) {
-        *out_record = temp_record;
-        closest_so_far = temp_record.t;
-        hit_any = 1;
-    }
-    // check for cylinder
-    if (cylinder_hit_help(cylinder_object, r_in, (interval){r_t.min, closest_so_far}, &temp_record)) {
-        *out_record = temp_record;
-        closest_so_far = temp_record.t;
-        hit_any = 1;
+    /// slab between the caps, rejects most rays before the quadratic
+    f64 slab_enter = -INFINITY;
+    f64 slab_exit = INFINITY;
+    if (zfabs(axial_speed) < DBL_EPSILON) {
+        if (axial_origin < 0.0 || axial_origin > shape->height) {
+            return false;
+        }
+    } else {
+        f64 t_bottom = -axial_origin / axial_speed;
+        f64 t_top = (shape->height - axial_origin) / axial_speed;
+        slab_enter = MIN(t_bottom, t_top);
+        slab_exit = MAX(t_bottom, t_top);
+        if (slab_enter >= r_t.max || slab_exit <= r_t.min) {
+            return false;
+        }
     }
 
-    return hit_any;
-}
-
-////////////////////////////////////////////////////////////
-//  __                  __                                //
-// /  |                /  |                               //
-// $$ |____    ______  $$ |  ______    ______    ______   //
-// $$      \  /      \ $$ | /      \  /      \  /      \  //
-// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  | //
-// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/  //
-// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       //
-// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |       //
-// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/        //
-//                         $$ |                           //
-//                         $$ |                           //
-//                         $$/                            //
-//                                                        //
-////////////////////////////////////////////////////////////
-
-bool cylinder_hit_help(hittable* cylinder_object, ray* r_in, interval r_t, hit_record* out_record) {
-    cylinder* shape = (cylinder*)cylinder_object;
-
-    vec3 E = vec3_cross(vec3_sub(r_in->origin, shape->bottom_center), shape->direction);
-    vec3 F = vec3_cross(r_in->direction, shape->direction);
-    f64 a = vec3_dot(F, F);
-    f64 half_b = vec3_dot(E, F);
-    f64 c = vec3_dot(E, E) - (shape->radius * shape->radius);
-    f64 discriminant = half_b * half_b - a * c;
+    /**
+     * @brief infinite cylinder, only the parts of the origin and direction perpendicular to the axis matter
+     * |oc_perp + t * dir_perp|^2 = radius^2
+     */
+    vec3 oc_perp = vec3_sub(oc, vec3_mul_scalar(axial_origin, shape->direction));
+    vec3 dir_perp = vec3_sub(r_in->direction, vec3_mul_scalar(axial_speed, shape->direction));
+    f64 a = vec3_dot(dir_perp, dir_perp);
+    f64 half_b = vec3_dot(oc_perp, dir_perp);
+    f64 c = vec3_dot(oc_perp, oc_perp) - shape->radius * shape->radius;
+    f64 side_enter = -INFINITY;
+    f64 side_exit = INFINITY;
+    if (a < DBL_EPSILON) {
+        if (c > 0.0) { // parallel to the axis and outside
+            return false;
+        }
+    } else {
+        f64 discriminant = half_b * half_b - a * c;
+        if (discriminant < 0.0) {
+            return false;
+        }
+        f64 sqrt_discriminant = zsqrt(discriminant);
+        side_enter = (-half_b - sqrt_discriminant) / a;
+        side_exit = (-half_b + sqrt_discriminant) / a;
+    }
 
-    if (discriminant < 0.0) {
+    f64 t_enter = MAX(slab_enter, side_enter);
+    f64 t_exit = MIN(slab_exit, side_exit);
+    if (t_enter > t_exit) {
+        return false;
+    }
+    /// cap: 0 for the side, -1 for the bottom cap, 1 for the top cap, the ray enters a slab at the cap facing it
+    f64 t;
+    i32 cap;
+    if (interval_surrounds(r_t, t_enter)) {
+        t = t_enter;
+        cap = slab_enter > side_enter ? (axial_speed > 0.0 ? -1 : 1) : 0;
+    } else if (t_enter <= r_t.min && interval_surrounds(r_t, t_exit)) {
+        t = t_exit;
+        cap = slab_exit < side_exit ? (axial_speed > 0.0 ? 1 : -1) : 0;
+    } else {
         return false;
     }
+    hit_record_set_hit(out_record, cylinder_object, t);
+    out_record->primitive_id = (u32)(cap + 1);
+    return true;
+}
 
-    f64 sqrt_discriminant = zsqrt(discriminant);
-    // getting smallest positive t
-    f64 t = (-half_b - sqrt_discriminant) / a;
-    if (!interval_surrounds(r_t, t)) {         // to stop multiple bounces which will result in dark color
-        t = (-half_b + sqrt_discriminant) / a; // second get the largest root
-        if (!interval_surrounds(r_t, t)) {
-            return false;
-        }
+void cylinder_surface(hittable* cylinder_object, ray* r_in, hit_record* record) {
+    cylinder* shape = (cylinder*)cylinder_object;
+    i32 cap = (i32)record->primitive_id - 1;
+    point3 point = ray_at(r_in, record->t);
+    record->point = point;
+    record->mat = shape->mat;
+    if (cap != 0) {
+        /// the caps map their disk like a circle, the bottom cap's frame is the top one with -tangent
+        vec3 dp = vec3_sub(point, cap > 0 ? shape->top_center : shape->bottom_center);
+        record->u = NDC_TO_UNIT(vec3_dot(dp, shape->bitangent) / shape->radius);
+        record->v = NDC_TO_UNIT(cap * vec3_dot(dp, shape->tangent) / shape->radius);
+        hit_record_set_face_normal(record, r_in, vec3_mul_scalar((f64)cap, shape->direction));
+        return;
     }
 
-    vec3 point = ray_at(r_in, t);
     vec3 inner_vec = vec3_sub(point, shape->bottom_center);
     f64 height = vec3_dot(inner_vec, shape->direction);
-    if (height < 0.0 || height > shape->height) {
-        return false;
-    }
-
     vec3 outward_normal = vec3_mul_scalar((1 / shape->radius),
                                           vec3_sub(inner_vec, vec3_mul_scalar(height, shape->direction)));
-    out_record->point = point;
-    out_record->mat = shape->mat;
-    out_record->t = t;
-    out_record->u = (zatan2(outward_normal.z, outward_normal.x) + PI) / (2 * PI);
-    out_record->v = height / shape->height;
-    hit_record_set_face_normal(out_record, r_in, outward_normal);
-
-    return true;
-}
\ No newline at end of file
+    record->u = (zatan2(outward_normal.z, outward_normal.x) + PI) / (2 * PI);
+    record->v = height / shape->height;
+    hit_record_set_face_normal(record, r_in, outward_normal);
+}
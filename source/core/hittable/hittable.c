@@ -0,0 +1,16 @@
+#include "hittable.h"
+
+void hittable_surface(ray* r_in, hit_record* record) {
+    // the ray in the space of every transform the hit went through, from the outermost one in
+    ray rays[HIT_RECORD_MAX_INSTANCES + 1];
+    u32 count = record->instance_count;
+    rays[count] = *r_in;
+    for (u32 i = count; i > 0; --i) {
+        rays[i - 1] = transform_ray_to_object(record->instances[i - 1], &rays[i]);
+    }
+    // the primitive works in its own space, then every transform moves the surface out, innermost first
+    record->object->surface(record->object, &rays[0], record);
+    for (u32 i = 0; i < count; ++i) {
+        transform_surface_to_world(record->instances[i], record);
+    }
+}
@@ -20,7 +20,15 @@
 ////////////////////////////////////////////////////////////////////////
 
 typedef struct material material;
+typedef struct hittable hittable;
+
+/// nesting depth of transforms a hit can go through (a transform in a bvh in a transform ...)
+#define HIT_RECORD_MAX_INSTANCES 8
 
+/**
+ * @brief the hit query (hittable.hit) only finds the closest t and what the primitive needs to rebuild the hit,
+ * the surface (point, normal, uv, material) is computed once for the closest hit with hittable_surface
+ */
 typedef struct hit_record {
     point3 point;    /// intersection point
     vec3 normal;     /// surface normal at intersection point (normal is always opposite to normal's dir)
@@ -29,11 +37,26 @@ typedef struct hit_record {
     f64 v;           /// texture coordinate v [0,1] along y axis
     bool front_face; /// if normal is opposite to ray's dir this is true else false
     material* mat;   /// material of object at intersection point
+    // written by the hit query
+    hittable* object;                                 /// primitive that was hit
+    f64 b1;                                           /// primitive specific (plane coordinates, barycentrics)
+    f64 b2;                                           /// primitive specific
+    u32 primitive_id;                                 /// primitive specific (mesh triangle, box face, cylinder cap)
+    u32 instance_count;                               /// number of transforms the hit went through
+    hittable* instances[HIT_RECORD_MAX_INSTANCES];    /// the transforms, innermost first
 } hit_record;
 
-typedef struct hittable hittable;
 struct hittable {
     bool (*hit)(hittable* object, ray* r_in, interval r_t, hit_record* out_record);
+    /// fills the surface of a hit found by this object's hit, 0 for objects that only hold other objects
+    void (*surface)(hittable* object, ray* r_in, hit_record* record);
+    /// true if anything is hit inside r_t, stops at the first hit it finds and writes no record (shadow rays)
+    bool (*occluded)(hittable* object, ray* r_in, interval r_t);
+    /// area light sampling, 0 for objects that can't be registered as lights (see hittable_list_add_light)
+    /// sample returns a direction from origin toward a random point of the object,
+    /// pdf is the solid angle density of sample picking direction (0 if it misses the object)
+    vec3 (*sample)(hittable* object, point3 origin);
+    f64 (*pdf)(hittable* object, point3 origin, vec3 direction);
     aabb box;
 };
 
@@ -41,6 +64,41 @@ INLINE bool default_hit(hittable* object, ray* r_in, interval r_t, hit_record* o
     return false;
 }
 
+/// a primitive's hit only writes t and a few ids, so its occlusion test is the hit itself on a scratch record
+INLINE bool primitive_occluded(hittable* object, ray* r_in, interval r_t) {
+    hit_record scratch;
+    return object->hit(object, r_in, r_t, &scratch);
+}
+
+/// solid angle pdf of a point picked uniformly on a flat light, seen from origin along direction
+INLINE f64 flat_light_pdf(hittable* object, point3 origin, vec3 direction, vec3 normal, f64 area) {
+    hit_record record;
+    ray r = ray_create(origin, direction);
+    if (!object->hit(object, &r, (interval){0.0001, INFINITY}, &record)) {
+        return 0.0;
+    }
+    f64 length_squared = vec3_length_squared(direction);
+    f64 distance_squared = record.t * record.t * length_squared;
+    f64 cosine = zfabs(vec3_dot(direction, normal)) / zsqrt(length_squared);
+    return distance_squared / (cosine * area);
+}
+
+/// every primitive's hit calls this when it accepts a closer hit
+INLINE void hit_record_set_hit(hit_record* record, hittable* object, f64 t) {
+    record->t = t;
+    record->object = object;
+    record->instance_count = 0;
+}
+
+/**
+ * @brief hittable_surface computes the point, normal, uv and material of the closest hit,
+ * call it once after the hit query returned true
+ *
+ * @param r_in the ray given to the hit query
+ * @param record record filled by the hit query
+ */
+void hittable_surface(ray* r_in, hit_record* record);
+
 INLINE void hit_record_set_face_normal(hit_record* record, ray* r_in, vec3 outward_normal) {
     /// this will ensure the normal is always opposite to ray's dir
     record->front_face = (vec3_dot(r_in->direction, outward_normal) < 0.0);
@@ -85,10 +143,20 @@ typedef struct sphere {
 
 bool sphere_hit(hittable* sphere_object, ray* r_in, interval r_t, hit_record* out_record);
 
+void sphere_surface(hittable* sphere_object, ray* r_in, hit_record* record);
+
+vec3 sphere_sample(hittable* sphere_object, point3 origin);
+
+f64 sphere_pdf(hittable* sphere_object, point3 origin, vec3 direction);
+
 INLINE sphere sphere_create(point3 center, f64 radius, material* mat) {
     return (sphere){
         .base = {
             .hit = sphere_hit,
+            .surface = sphere_surface,
+            .occluded = primitive_occluded,
+            .sample = sphere_sample,
+            .pdf = sphere_pdf,
             .box = aabb_create(vec3_sub(center, (vec3){radius, radius, radius}),
                                vec3_add(center, (vec3){radius, radius, radius})),
         },
@@ -128,12 +196,22 @@ typedef struct quad {
 
 bool quad_hit(hittable* quad_object, ray* r_in, interval r_t, hit_record* out_record);
 
+void quad_surface(hittable* quad_object, ray* r_in, hit_record* record);
+
+vec3 quad_sample(hittable* quad_object, point3 origin);
+
+f64 quad_pdf(hittable* quad_object, point3 origin, vec3 direction);
+
 INLINE quad quad_create(point3 Q, vec3 u, vec3 v, material* mat) {
     vec3 n = vec3_cross(u, v);
     vec3 normal = vec3_unit(n);
     return (quad){
         .base = {
             .hit = quad_hit,
+            .surface = quad_surface,
+            .occluded = primitive_occluded,
+            .sample = quad_sample,
+            .pdf = quad_pdf,
             .box = aabb_merge(aabb_create(Q, vec3_add(Q, vec3_add(u, v))), // the quad maybe tilted along the diagnoal so;
                               aabb_create(vec3_add(Q, u), vec3_add(Q, v))),
         },
@@ -177,12 +255,22 @@ typedef struct triangle {
 
 bool triangle_hit(hittable* triangle_object, ray* r_in, interval r_t, hit_record* out_record);
 
+void triangle_surface(hittable* triangle_object, ray* r_in, hit_record* record);
+
+vec3 triangle_sample(hittable* triangle_object, point3 origin);
+
+f64 triangle_pdf(hittable* triangle_object, point3 origin, vec3 direction);
+
 INLINE triangle triangle_create(point3 Q, vec3 u, vec3 v, material* mat) {
     vec3 n = vec3_cross(u, v);
     vec3 normal = vec3_unit(n);
     return (triangle){
         .base = {
             .hit = triangle_hit,
+            .surface = triangle_surface,
+            .occluded = primitive_occluded,
+            .sample = triangle_sample,
+            .pdf = triangle_pdf,
             .box = aabb_merge(aabb_create(Q, vec3_add(Q, vec3_add(u, v))), // the triangle maybe tilted along the diagnoal so;
                               aabb_create(vec3_add(Q, u), vec3_add(Q, v))),
         },
@@ -222,6 +310,12 @@ typedef struct circle {
 
 bool circle_hit(hittable* circle_object, ray* r_in, interval r_t, hit_record* out_record);
 
+void circle_surface(hittable* circle_object, ray* r_in, hit_record* record);
+
+vec3 circle_sample(hittable* circle_object, point3 origin);
+
+f64 circle_pdf(hittable* circle_object, point3 origin, vec3 direction);
+
 INLINE circle circle_create(point3 center, f64 radius, vec3 normal, material* mat) {
     normal = vec3_unit(normal);
     vec3 tangent = vec3_cross(normal, (vec3){1, 0, 0});
@@ -230,13 +324,20 @@ INLINE circle circle_create(point3 center, f64 radius, vec3 normal, material* ma
     }
     tangent = vec3_unit(tangent);
     vec3 bitangent = vec3_cross(tangent, normal);
-    vec3 extent1 = vec3_mul_scalar(radius, tangent);
-    vec3 extent2 = vec3_mul_scalar(radius, bitangent);
+    /// the disk reaches radius * sqrt(1 - normal_i^2) from the center along axis i
+    vec3 extent = {
+        radius * zsqrt(MAX(0.0, 1.0 - normal.x * normal.x)),
+        radius * zsqrt(MAX(0.0, 1.0 - normal.y * normal.y)),
+        radius * zsqrt(MAX(0.0, 1.0 - normal.z * normal.z)),
+    };
     return (circle){
         .base = {
             .hit = circle_hit,
-            .box = aabb_create(vec3_sub(center, vec3_add(extent1, extent2)),
-                               vec3_add(center, vec3_add(extent1, extent2))),
+            .surface = circle_surface,
+            .occluded = primitive_occluded,
+            .sample = circle_sample,
+            .pdf = circle_pdf,
+            .box = aabb_create(vec3_sub(center, extent), vec3_add(center, extent)),
         },
         .mat = mat,
         .center = center,
@@ -267,13 +368,13 @@ INLINE circle circle_create(point3 center, f64 radius, vec3 normal, material* ma
 typedef struct cylinder {
     hittable base;
     material* mat;
-    vec3 direction;
+    vec3 direction; /// unit axis from the bottom cap to the top cap
     f64 height;
     f64 radius;
     point3 bottom_center;
     point3 top_center;
-    circle bottom_circle;
-    circle top_circle;
+    vec3 tangent;   /// uv frame of the top cap (the bottom cap uses -tangent), perpendicular to direction
+    vec3 bitangent;
 } cylinder;
 
 bool cylinder_hit(hittable* cylinder_object,
@@ -281,6 +382,8 @@ bool cylinder_hit(hittable* cylinder_object,
                   interval r_t,
                   hit_record* out_record);
 
+void cylinder_surface(hittable* cylinder_object, ray* r_in, hit_record* record);
+
 INLINE cylinder cylinder_create(point3 cylinder_bottom_center,
                                 vec3 cylinder_direction,
                                 f64 cylinder_height,
@@ -288,10 +391,25 @@ INLINE cylinder cylinder_create(point3 cylinder_bottom_center,
                                 material* mat) {
     cylinder_direction = vec3_unit(cylinder_direction);
     point3 cylinder_top_center = vec3_add(cylinder_bottom_center, vec3_mul_scalar(cylinder_height, cylinder_direction));
+    /// same frame as a circle_create of the top cap
+    vec3 tangent = vec3_cross(cylinder_direction, (vec3){1, 0, 0});
+    if (vec3_length(tangent) < 1e-8) {
+        tangent = vec3_cross(cylinder_direction, (vec3){0, 1, 0});
+    }
+    tangent = vec3_unit(tangent);
+    /// the caps reach radius * sqrt(1 - direction_i^2) from their centers along axis i
+    vec3 extent = {
+        cylinder_radius * zsqrt(MAX(0.0, 1.0 - cylinder_direction.x * cylinder_direction.x)),
+        cylinder_radius * zsqrt(MAX(0.0, 1.0 - cylinder_direction.y * cylinder_direction.y)),
+        cylinder_radius * zsqrt(MAX(0.0, 1.0 - cylinder_direction.z * cylinder_direction.z)),
+    };
     return (cylinder){
         .base = {
             .hit = cylinder_hit,
-            .box = aabb_expand(aabb_create(cylinder_bottom_center, cylinder_top_center), 2 * cylinder_radius),
+            .surface = cylinder_surface,
+            .occluded = primitive_occluded,
+            .box = aabb_merge(aabb_create(vec3_sub(cylinder_bottom_center, extent), vec3_add(cylinder_bottom_center, extent)),
+                              aabb_create(vec3_sub(cylinder_top_center, extent), vec3_add(cylinder_top_center, extent))),
         },
         .mat = mat,
         .direction = cylinder_direction,
@@ -299,8 +417,8 @@ INLINE cylinder cylinder_create(point3 cylinder_bottom_center,
         .radius = cylinder_radius,
         .bottom_center = cylinder_bottom_center,
         .top_center = cylinder_top_center,
-        .bottom_circle = circle_create(cylinder_bottom_center, cylinder_radius, vec3_mul_scalar(-1.0, cylinder_direction), mat),
-        .top_circle = circle_create(cylinder_top_center, cylinder_radius, cylinder_direction, mat),
+        .tangent = tangent,
+        .bitangent = vec3_cross(tangent, cylinder_direction),
     };
 }
 
@@ -317,100 +435,67 @@ INLINE cylinder cylinder_create(point3 cylinder_bottom_center,
 //                                                                                                    //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/////////////////////////////////////////////////////////////////////////////////////////
-//    __                                             __              __                //
-//   /  |                                           /  |            /  |               //
-//  _$$ |_     ______   ______   _______    _______ $$ |  ______   _$$ |_     ______   //
-// / $$   |   /      \ /      \ /       \  /       |$$ | /      \ / $$   |   /      \  //
-// $$$$$$/   /$$$$$$  |$$$$$$  |$$$$$$$  |/$$$$$$$/ $$ | $$$$$$  |$$$$$$/   /$$$$$$  | //
-//   $$ | __ $$ |  $$/ /    $$ |$$ |  $$ |$$      \ $$ | /    $$ |  $$ | __ $$    $$ | //
-//   $$ |/  |$$ |     /$$$$$$$ |$$ |  $$ | $$$$$$  |$$ |/$$$$$$$ |  $$ |/  |$$$$$$$$/  //
-//   $$  $$/ $$ |     $$    $$ |$$ |  $$ |/     $$/ $$ |$$    $$ |  $$  $$/ $$       | //
-//    $$$$/  $$/       $$$$$$$/ $$/   $$/ $$$$$$$/  $$/  $$$$$$$/    $$$$/   $$$$$$$/  //
-//                                                                                     //
-/////////////////////////////////////////////////////////////////////////////////////////
-
-typedef struct translate {
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//    __                                              ______                                   //
+//   /  |                                            /      \                                  //
+//  _$$ |_     ______   ______   _______    _______ /$$$$$$  |______    ______   _____  ____   //
+// / $$   |   /      \ /      \ /       \  /       |$$ |_ $$//      \  /      \ /     \/    \  //
+// $$$$$$/   /$$$$$$  |$$$$$$  |$$$$$$$  |/$$$$$$$/ $$   |  /$$$$$$  |/$$$$$$  |$$$$$$ $$$$  | //
+//   $$ | __ $$ |  $$/ /    $$ |$$ |  $$ |$$      \ $$$$/   $$ |  $$ |$$ |  $$/ $$ | $$ | $$ | //
+//   $$ |/  |$$ |     /$$$$$$$ |$$ |  $$ | $$$$$$  |$$ |    $$ \__$$ |$$ |      $$ | $$ | $$ | //
+//   $$  $$/ $$ |     $$    $$ |$$ |  $$ |/     $$/ $$ |    $$    $$/ $$ |      $$ | $$ | $$ | //
+//    $$$$/  $$/       $$$$$$$/ $$/   $$/ $$$$$$$/  $$/      $$$$$$/  $$/       $$/  $$/  $$/  //
+//                                                                                             //
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct transform {
     hittable base;
-    hittable* object;
-    vec3 offset;
-    material* mat;
-} translate;
-
-INLINE bool translate_hit(hittable* object, ray* r_in, interval r_t, hit_record* record) {
-    translate* trans = (translate*)object;
-    ray r = {
-        .origin = vec3_sub(r_in->origin, trans->offset),
-        .direction = r_in->direction,
-    };
-    if (!trans->object->hit(trans->object, &r, r_t, record)) {
-        return false;
-    }
-    record->point = vec3_add(record->point, trans->offset);
-    record->mat = trans->mat;
-    return true;
-}
-
-INLINE translate translate_object(hittable* object, vec3 offset, material* mat) {
-    return (translate){
+    hittable* object;       /// child object, in its own space
+    mat3x4 object_to_world; /// places the object in the world
+    mat3x4 world_to_object; /// inverse of object_to_world, moves the rays into the object's space
+    mat3x4 normal_to_world; /// inverse transpose of the linear part (no translation), moves the normals into the world
+    material* mat;          /// overrides the materials of the object, 0 keeps them
+} transform;
+
+bool transform_hit(hittable* transform_object, ray* r_in, interval r_t, hit_record* out_record);
+
+bool transform_occluded(hittable* transform_object, ray* r_in, interval r_t);
+
+/// the ray in the space of the transformed object
+ray transform_ray_to_object(hittable* transform_object, ray* r_in);
+
+/// moves a surface computed in the object's space into the world and applies the material override
+void transform_surface_to_world(hittable* transform_object, hit_record* record);
+
+/// every matrix is computed here once, object_to_world can be any invertible affine transform
+/// (chain translations, rotations and scales with mat3x4_mul instead of nesting transforms)
+INLINE transform transform_create(hittable* object, mat3x4 object_to_world, material* mat) {
+    mat3x4 world_to_object = mat3x4_inverse(object_to_world);
+    mat3x4 normal_to_world = {{
+        {world_to_object.m[0][0], world_to_object.m[1][0], world_to_object.m[2][0], 0},
+        {world_to_object.m[0][1], world_to_object.m[1][1], world_to_object.m[2][1], 0},
+        {world_to_object.m[0][2], world_to_object.m[1][2], world_to_object.m[2][2], 0},
+    }};
+    return (transform){
         .base = {
-            .hit = translate_hit,
-            .box = aabb_translate(&object->box, offset),
+            .hit = transform_hit,
+            .occluded = transform_occluded,
+            .box = aabb_transform(&object->box, &object_to_world),
         },
         .object = object,
-        .offset = offset,
+        .object_to_world = object_to_world,
+        .world_to_object = world_to_object,
+        .normal_to_world = normal_to_world,
         .mat = mat,
     };
 }
 
-//////////////////////////////////////////////////////////////////
-//                        __                  __                //
-//                       /  |                /  |               //
-//   ______    ______   _$$ |_     ______   _$$ |_     ______   //
-//  /      \  /      \ / $$   |   /      \ / $$   |   /      \  //
-// /$$$$$$  |/$$$$$$  |$$$$$$/    $$$$$$  |$$$$$$/   /$$$$$$  | //
-// $$ |  $$/ $$ |  $$ |  $$ | __  /    $$ |  $$ | __ $$    $$ | //
-// $$ |      $$ \__$$ |  $$ |/  |/$$$$$$$ |  $$ |/  |$$$$$$$$/  //
-// $$ |      $$    $$/   $$  $$/ $$    $$ |  $$  $$/ $$       | //
-// $$/        $$$$$$/     $$$$/   $$$$$$$/    $$$$/   $$$$$$$/  //
-//                                                              //
-//////////////////////////////////////////////////////////////////
-
-typedef struct rotate {
-    hittable base;
-    hittable* object;
-    vec3 axis;
-    f64 rad;
-    material* mat;
-} rotate;
-
-INLINE bool rotate_hit(hittable* object, ray* r_in, interval r_t, hit_record* record) {
-    rotate* rota = (rotate*)object;
-    mat3 mtx = mat3_rotation(rota->rad * -1.0, rota->axis);
-    ray r = {
-        .origin = mat3_mul_vec3(mtx, r_in->origin),
-        .direction = mat3_mul_vec3(mtx, r_in->direction),
-    };
-    if (!rota->object->hit(rota->object, &r, r_t, record)) {
-        return false;
-    }
-    record->point = mat3_mul_vec3(mat3_rotation(rota->rad, rota->axis), record->point);
-    record->mat = rota->mat;
-    return true;
+INLINE transform translate_object(hittable* object, vec3 offset, material* mat) {
+    return transform_create(object, mat3x4_translation(offset), mat);
 }
 
-// NOTE: make sure the object's is symmetrical aligned with axis before rotating the object (to get correct results)
-INLINE rotate rotate_object(hittable* object, vec3 axis, f64 rad, material* mat) {
-    return (rotate){
-        .base = {
-            .hit = rotate_hit,
-            .box = object->box,
-        },
-        .object = object,
-        .axis = axis,
-        .rad = rad,
-        .mat = mat,
-    };
+INLINE transform rotate_object(hittable* object, vec3 axis, f64 rad, material* mat) {
+    return transform_create(object, mat3x4_rotation(rad, axis), mat);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -435,10 +520,14 @@ typedef struct constant_medium {
 
 bool constant_medium_hit(hittable* object, ray* r_in, interval r_t, hit_record* record);
 
+void constant_medium_surface(hittable* object, ray* r_in, hit_record* record);
+
 INLINE constant_medium constant_medium_create(hittable* object, f64 density, material* mat) {
     return (constant_medium){
         .base = {
             .hit = constant_medium_hit,
+            .surface = constant_medium_surface,
+            .occluded = primitive_occluded,
             .box = object->box,
         },
         .object = object,
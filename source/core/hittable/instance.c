@@ -0,0 +1,32 @@
+#include "instance.h"
+#include "darray.h"
+#include "bvh.h"
+#include "logger.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//  __                        __                                              //
+// /  |                      /  |                                             //
+// $$/  _______    _______  _$$ |_     ______   _______    _______   ______   //
+// /  |/       \  /       |/ $$   |   /      \ /       \  /       | /      \  //
+// $$ |$$$$$$$  |/$$$$$$$/ $$$$$$/    $$$$$$  |$$$$$$$  |/$$$$$$$/ /$$$$$$  | //
+// $$ |$$ |  $$ |$$      \   $$ | __  /    $$ |$$ |  $$ |$$ |      $$    $$ | //
+// $$ |$$ |  $$ | $$$$$$  |  $$ |/  |/$$$$$$$ |$$ |  $$ |$$ \_____ $$$$$$$$/  //
+// $$ |$$ |  $$ |/     $$/   $$  $$/ $$    $$ |$$ |  $$ |$$       |$$       | //
+// $$/ $$/   $$/ $$$$$$$/     $$$$/   $$$$$$$/ $$/   $$/  $$$$$$$/  $$$$$$$/  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+hittable* instance_tlas_create(instance* instances, u32 count) {
+    if (instances == 0 || count == 0) {
+        LOGE("instance_tlas_create: invalid params");
+        return 0;
+    }
+    hittable** darray = darray_create(hittable*);
+    for (u32 i = 0; i < count; ++i) {
+        hittable* object = (hittable*)(instances + i);
+        darray = _darray_push_back(darray, &object);
+    }
+    hittable* tlas = bvh_create_sah(darray);
+    darray_destroy(darray);
+    return tlas;
+}
@@ -0,0 +1,24 @@
+#ifndef INSTANCE__H
+#define INSTANCE__H
+
+#include "hittable.h"
+
+/**
+ * @brief instancing: a shared object (usually a bvh of a mesh or of a group of objects) is built once
+ * and every copy is a transform of it (see transform_create), so every instance only stores its matrices
+ * and material and scenes with many copies of a few objects stay small, instance_tlas_create puts the
+ * instances in a top level bvh so they are traced in log time
+ */
+typedef transform instance;
+
+/**
+ * @brief instance_tlas_create builds the top level bvh (sah) over the instances
+ * trace it like any other bvh and free it with bvh_destroy, the instances are not copied
+ *
+ * @param instances array of instances
+ * @param count number of instances
+ * @return hittable*
+ */
+hittable* instance_tlas_create(instance* instances, u32 count);
+
+#endif
@@ -36,15 +36,32 @@ bool quad_hit(hittable* quad_object, ray* r_in, interval r_t, hit_record* out_re
     if (alpha < 0.0 || alpha > 1.0 || beta < 0.0 || beta > 1.0) {
         return false;
     }
-    out_record->point = point;
-    out_record->mat = qu->mat;
-    out_record->t = t;
-    out_record->u = alpha;
-    out_record->v = beta;
-    hit_record_set_face_normal(out_record, r_in, qu->normal);
+    hit_record_set_hit(out_record, quad_object, t);
+    out_record->b1 = alpha;
+    out_record->b2 = beta;
+    return true;
+}
+
+void quad_surface(hittable* quad_object, ray* r_in, hit_record* record) {
+    quad* qu = (quad*)quad_object;
+    record->point = ray_at(r_in, record->t);
+    record->mat = qu->mat;
+    record->u = record->b1;
+    record->v = record->b2;
+    hit_record_set_face_normal(record, r_in, qu->normal);
 
     // this will be true only if u,v are only |_ 90*
     //  record->u = point.x - qu->Q.x;
     //  record->v = point.y - qu->Q.y;
-    return true;
-}
\ No newline at end of file
+}
+
+vec3 quad_sample(hittable* quad_object, point3 origin) {
+    quad* qu = (quad*)quad_object;
+    point3 point = vec3_add(qu->Q, vec3_add(vec3_mul_scalar(random_unit(), qu->u), vec3_mul_scalar(random_unit(), qu->v)));
+    return vec3_sub(point, origin);
+}
+
+f64 quad_pdf(hittable* quad_object, point3 origin, vec3 direction) {
+    quad* qu = (quad*)quad_object;
+    return flat_light_pdf(quad_object, origin, direction, qu->normal, vec3_length(vec3_cross(qu->u, qu->v)));
+}
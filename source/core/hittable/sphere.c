@@ -21,31 +21,76 @@ bool sphere_hit(hittable* sphere_object, ray* r_in, interval r_t, hit_record* ou
 
     sphere* object = (sphere*)(sphere_object);
     vec3 oc = vec3_sub(object->center, r_in->origin); // Origin_to_CircleCenter vector
-    f32 a = vec3_length_squared(r_in->direction);
-    f32 half_b = vec3_dot(oc, r_in->direction);
-    f32 c = vec3_length_squared(oc) - (object->radius * object->radius);
-    f32 discriminant = half_b * half_b - a * c;
+    f64 a = vec3_length_squared(r_in->direction);
+    f64 half_b = vec3_dot(oc, r_in->direction);
+    f64 c = vec3_length_squared(oc) - (object->radius * object->radius);
+    f64 discriminant = half_b * half_b - a * c;
     if (discriminant < 0) {
         return false;
     }
-    f32 sqrtd = zsqrt(discriminant);
-    f32 root = (half_b - sqrtd) / a;      // first get the smallest root
+    f64 sqrtd = zsqrt(discriminant);
+    f64 root = (half_b - sqrtd) / a;      // first get the smallest root
     if (!interval_surrounds(r_t, root)) { // to stop multiple bounces which will result in dark color
         root = (half_b + sqrtd) / a;      // second get the largest root
         if (!interval_surrounds(r_t, root)) {
             return false;
         }
     }
-    vec3 point = ray_at(r_in, root);
-    vec3 outward_normal = vec3_mul_scalar((1.0 / object->radius), vec3_sub(point, object->center)); // normalize the normal
-    f32 hori_angle = zacos(-outward_normal.y);
-    f32 vert_angle = zatan2(outward_normal.z, outward_normal.x) + PI;
-
-    out_record->t = root;
-    out_record->point = point;
-    out_record->mat = object->mat;
-    out_record->u = vert_angle / (PI * 2.0);
-    out_record->v = hori_angle / PI;
-    hit_record_set_face_normal(out_record, r_in, outward_normal);
+    hit_record_set_hit(out_record, sphere_object, root);
     return true;
-}
\ No newline at end of file
+}
+
+void sphere_surface(hittable* sphere_object, ray* r_in, hit_record* record) {
+    sphere* object = (sphere*)(sphere_object);
+    vec3 point = ray_at(r_in, record->t);
+    vec3 outward_normal = vec3_mul_scalar((1.0 / object->radius), vec3_sub(point, object->center)); // normalize the normal
+    f64 hori_angle = zacos(-outward_normal.y);
+    f64 vert_angle = zatan2(outward_normal.z, outward_normal.x) + PI;
+
+    record->point = point;
+    record->mat = object->mat;
+    record->u = vert_angle / (PI * 2.0);
+    record->v = hori_angle / PI;
+    hit_record_set_face_normal(record, r_in, outward_normal);
+}
+
+/**
+ * @brief seen from outside the sphere covers a cone of directions around the center, cos_max = sqrt(1 - r^2/d^2)
+ * directions are picked uniformly inside that cone, so every one of them hits the sphere
+ */
+vec3 sphere_sample(hittable* sphere_object, point3 origin) {
+    sphere* object = (sphere*)(sphere_object);
+    vec3 to_center = vec3_sub(object->center, origin);
+    f64 distance_squared = vec3_length_squared(to_center);
+    f64 radius_squared = object->radius * object->radius;
+    if (distance_squared <= radius_squared) {
+        return vec3_random_unit_vector(); // inside, sphere_pdf is 0 so the sample is never used
+    }
+    f64 cos_max = zsqrt(1.0 - radius_squared / distance_squared);
+    f64 z = 1.0 + random_unit() * (cos_max - 1.0);
+    f64 sin_z = zsqrt(MAX(0.0, 1.0 - z * z));
+    f64 phi = 2.0 * PI * random_unit();
+
+    vec3 w = vec3_mul_scalar(1.0 / zsqrt(distance_squared), to_center);
+    vec3 v = vec3_unit(vec3_cross(w, zfabs(w.x) > 0.9 ? (vec3){0.0, 1.0, 0.0} : (vec3){1.0, 0.0, 0.0}));
+    vec3 u = vec3_cross(w, v);
+    return vec3_add(vec3_mul_scalar(z, w), vec3_add(vec3_mul_scalar(sin_z * zcos(phi), u), vec3_mul_scalar(sin_z * zsin(phi), v)));
+}
+
+f64 sphere_pdf(hittable* sphere_object, point3 origin, vec3 direction) {
+    sphere* object = (sphere*)(sphere_object);
+    hit_record record;
+    ray r = ray_create(origin, direction);
+    if (!sphere_hit(sphere_object, &r, (interval){0.0001, INFINITY}, &record)) {
+        return 0.0;
+    }
+    f64 distance_squared = vec3_distance_squared(object->center, origin);
+    f64 radius_squared = object->radius * object->radius;
+    if (distance_squared <= radius_squared) {
+        return 0.0;
+    }
+    // 1 - cos_max written as (r^2/d^2) / (1 + cos_max) so a far away light doesn't round to a 0 solid angle
+    f64 ratio = radius_squared / distance_squared;
+    f64 solid_angle = 2.0 * PI * ratio / (1.0 + zsqrt(1.0 - ratio));
+    return 1.0 / solid_angle;
+}
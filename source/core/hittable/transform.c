@@ -0,0 +1,41 @@
+#include "hittable.h"
+#include "asserts.h"
+
+bool transform_hit(hittable* transform_object, ray* r_in, interval r_t, hit_record* out_record) {
+    transform* trans = (transform*)transform_object;
+    ray r = transform_ray_to_object(transform_object, r_in);
+    if (!trans->object->hit(trans->object, &r, r_t, out_record)) {
+        return false;
+    }
+    // the surface is computed in the object's space and brought back by hittable_surface
+    // the child already wrote the record so the hit is kept even past the limit, only that placement is lost
+    ASSERT(out_record->instance_count < HIT_RECORD_MAX_INSTANCES);
+    if (out_record->instance_count < HIT_RECORD_MAX_INSTANCES) {
+        out_record->instances[out_record->instance_count++] = transform_object;
+    }
+    return true;
+}
+
+bool transform_occluded(hittable* transform_object, ray* r_in, interval r_t) {
+    transform* trans = (transform*)transform_object;
+    ray r = transform_ray_to_object(transform_object, r_in);
+    return trans->object->occluded(trans->object, &r, r_t);
+}
+
+ray transform_ray_to_object(hittable* transform_object, ray* r_in) {
+    transform* trans = (transform*)transform_object;
+    // the direction is not normalized so t is the same in both spaces
+    return ray_create(mat3x4_mul_point(&trans->world_to_object, r_in->origin),
+                      mat3x4_mul_vec3(&trans->world_to_object, r_in->direction));
+}
+
+void transform_surface_to_world(hittable* transform_object, hit_record* record) {
+    transform* trans = (transform*)transform_object;
+    record->point = mat3x4_mul_point(&trans->object_to_world, record->point);
+    // the normal matrix keeps the normals perpendicular under non uniform scales
+    // and keeps the side they face, so front_face is still valid
+    record->normal = vec3_unit(mat3x4_mul_vec3(&trans->normal_to_world, record->normal));
+    if (trans->mat) {
+        record->mat = trans->mat;
+    }
+}
@@ -20,12 +20,34 @@ bool triangle_hit(hittable* triangle_object, ray* r_in, interval r_t, hit_record
     if (alpha < 0.0 || alpha > 1.0 || beta < 0.0 || beta > 1.0 || alpha + beta > 1.0) { /// only triangle check is (a + b) > 1
         return false;
     }
-    out_record->point = point;
-    out_record->mat = tri->mat;
-    out_record->t = t;
-    out_record->u = alpha;
-    out_record->v = beta;
-    hit_record_set_face_normal(out_record, r_in, tri->normal);
-
+    hit_record_set_hit(out_record, triangle_object, t);
+    out_record->b1 = alpha;
+    out_record->b2 = beta;
     return true;
-}
\ No newline at end of file
+}
+
+void triangle_surface(hittable* triangle_object, ray* r_in, hit_record* record) {
+    triangle* tri = (triangle*)triangle_object;
+    record->point = ray_at(r_in, record->t);
+    record->mat = tri->mat;
+    record->u = record->b1;
+    record->v = record->b2;
+    hit_record_set_face_normal(record, r_in, tri->normal);
+}
+
+vec3 triangle_sample(hittable* triangle_object, point3 origin) {
+    triangle* tri = (triangle*)triangle_object;
+    f64 alpha = random_unit();
+    f64 beta = random_unit();
+    if (alpha + beta > 1.0) { /// fold the other half of the parallelogram back onto the triangle
+        alpha = 1.0 - alpha;
+        beta = 1.0 - beta;
+    }
+    point3 point = vec3_add(tri->Q, vec3_add(vec3_mul_scalar(alpha, tri->u), vec3_mul_scalar(beta, tri->v)));
+    return vec3_sub(point, origin);
+}
+
+f64 triangle_pdf(hittable* triangle_object, point3 origin, vec3 direction) {
+    triangle* tri = (triangle*)triangle_object;
+    return flat_light_pdf(triangle_object, origin, direction, tri->normal, 0.5 * vec3_length(vec3_cross(tri->u, tri->v)));
+}
@@ -0,0 +1,550 @@
+#include "triangle_mesh.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "asserts.h"
+
+#define MESH_BIN_COUNT 16
+#define MESH_MAX_LEAF_SIZE 4
+#define MESH_TRAVERSAL_COST 1.0
+#define MESH_INTERSECTION_COST 1.0
+#define MESH_STACK_SIZE 64
+// past this depth nodes are split in two halves by count, the build lowers it for big meshes so the count splits
+// still fit the traversal stack
+#define MESH_MAX_SAH_DEPTH 40
+// the slab distances are rounded, without this far bound padding (Ize 2013, "Robust BVH Ray Traversal") a ray
+// through a vertex that lies on a node's bounds can miss the node and leak through an otherwise watertight mesh
+#define MESH_SLAB_PAD (1.0 + 4.0 * DBL_EPSILON)
+
+// 32 bytes, stored depth first so the first child of an inner node is always the next node
+struct triangle_mesh_node {
+    f32 bounds[2][3];   // min, max (indexed by the ray's direction sign)
+    u32 offset;         // leaf: first triangle, inner: index of the second child
+    u16 triangle_count; // 0 for inner nodes
+    u8 axis;            // split axis of inner nodes
+    u8 pad;
+};
+
+typedef struct mesh_build {
+    triangle_mesh* mesh;
+    f32* boxes;     // 6 per triangle: min xyz, max xyz
+    f32* centroids; // 3 per triangle
+    u32* order;     // triangles in leaf order once the build is done
+    u32 node_count;
+    u32 max_sah_depth;
+    u32 depth; // deepest node
+} mesh_build;
+
+typedef struct mesh_bin {
+    f32 box[6];
+    u32 count;
+} mesh_bin;
+
+STATIC_ASSERT(sizeof(triangle_mesh_node) == 32);
+
+u32 build_mesh_node(mesh_build* build, u32 start, u32 end, u32 depth);
+void mesh_build_free(mesh_build* build, u32 count);
+void mesh_box_empty(f32* box);
+void mesh_box_merge(f32* box, const f32* other);
+f64 mesh_box_area(const f32* box);
+
+//////////////////////////////////////////////////
+//                                    __        //
+//                                   /  |       //
+//  _____  ____    ______    _______ $$ |____   //
+// /     \/    \  /      \  /       |$$      \  //
+// $$$$$$ $$$$  |/$$$$$$  |/$$$$$$$/ $$$$$$$  | //
+// $$ | $$ | $$ |$$    $$ |$$      \ $$ |  $$ | //
+// $$ | $$ | $$ |$$$$$$$$/  $$$$$$  |$$ |  $$ | //
+// $$ | $$ | $$ |$$       |/     $$/ $$ |  $$ | //
+// $$/  $$/  $$/  $$$$$$$/ $$$$$$$/  $$/   $$/  //
+//                                              //
+//////////////////////////////////////////////////
+
+triangle_mesh* triangle_mesh_allocate(u32 vertex_count, u32 triangle_count, bool has_normals, bool has_uvs, material* mat) {
+    if (vertex_count == 0 || triangle_count == 0) {
+        LOGE("triangle_mesh_allocate: invalid params");
+        return 0;
+    }
+    triangle_mesh* mesh = zmemory_allocate(sizeof(triangle_mesh));
+    if (mesh == 0) {
+        LOGE("triangle_mesh_allocate: out of memory");
+        return 0;
+    }
+    mesh->base.hit = triangle_mesh_hit;
+    mesh->base.surface = triangle_mesh_surface;
+    mesh->base.occluded = triangle_mesh_occluded;
+    mesh->mat = mat;
+    mesh->vertex_count = vertex_count;
+    mesh->triangle_count = triangle_count;
+    mesh->positions = zmemory_allocate((u64)vertex_count * 3 * sizeof(f32));
+    mesh->normals = has_normals ? zmemory_allocate((u64)vertex_count * 3 * sizeof(f32)) : 0;
+    mesh->uvs = has_uvs ? zmemory_allocate((u64)vertex_count * 2 * sizeof(f32)) : 0;
+    mesh->indices = zmemory_allocate((u64)triangle_count * 3 * sizeof(u32));
+    if (mesh->positions == 0 || (has_normals && mesh->normals == 0) || (has_uvs && mesh->uvs == 0) || mesh->indices == 0) {
+        LOGE("triangle_mesh_allocate: out of memory for %u vertices and %u triangles", vertex_count, triangle_count);
+        triangle_mesh_destroy(mesh);
+        return 0;
+    }
+    return mesh;
+}
+
+triangle_mesh* triangle_mesh_create(const f32* positions, const f32* normals, const f32* uvs, u32 vertex_count,
+                                    const u32* indices, u32 triangle_count, material* mat) {
+    if (positions == 0 || indices == 0 || vertex_count == 0 || triangle_count == 0) {
+        LOGE("triangle_mesh_create: invalid params");
+        return 0;
+    }
+    triangle_mesh* mesh = triangle_mesh_allocate(vertex_count, triangle_count, normals != 0, uvs != 0, mat);
+    if (mesh == 0) {
+        return 0;
+    }
+    zmemory_copy(mesh->positions, positions, (u64)vertex_count * 3 * sizeof(f32));
+    if (normals) {
+        zmemory_copy(mesh->normals, normals, (u64)vertex_count * 3 * sizeof(f32));
+    }
+    if (uvs) {
+        zmemory_copy(mesh->uvs, uvs, (u64)vertex_count * 2 * sizeof(f32));
+    }
+    zmemory_copy(mesh->indices, indices, (u64)triangle_count * 3 * sizeof(u32));
+    if (!triangle_mesh_build(mesh)) {
+        triangle_mesh_destroy(mesh);
+        return 0;
+    }
+    return mesh;
+}
+
+bool triangle_mesh_build(triangle_mesh* mesh) {
+    if (mesh == 0 || mesh->nodes != 0) {
+        LOGE("triangle_mesh_build: invalid params");
+        return false;
+    }
+    u32 count = mesh->triangle_count;
+    for (u64 i = 0; i < (u64)count * 3; ++i) {
+        if (mesh->indices[i] >= mesh->vertex_count) {
+            LOGE("triangle_mesh_build: index %u of triangle %llu is out of range", mesh->indices[i], i / 3);
+            return false;
+        }
+    }
+
+    // every inner node has two children and every leaf at least one triangle
+    u32 capacity = 2 * count - 1;
+    mesh_build build = {.mesh = mesh};
+    build.boxes = zmemory_allocate((u64)count * 6 * sizeof(f32));
+    build.centroids = zmemory_allocate((u64)count * 3 * sizeof(f32));
+    build.order = zmemory_allocate((u64)count * sizeof(u32));
+    mesh->nodes = zmemory_allocate((u64)capacity * sizeof(triangle_mesh_node));
+    if (build.boxes == 0 || build.centroids == 0 || build.order == 0 || mesh->nodes == 0) {
+        LOGE("triangle_mesh_build: out of memory for %u triangles", count);
+        if (mesh->nodes) {
+            zmemory_free(mesh->nodes, (u64)capacity * sizeof(triangle_mesh_node));
+            mesh->nodes = 0;
+        }
+        mesh_build_free(&build, count);
+        return false;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        f32* box = build.boxes + (u64)i * 6;
+        mesh_box_empty(box);
+        for (u32 k = 0; k < 3; ++k) {
+            const f32* p = mesh->positions + (u64)mesh->indices[(u64)i * 3 + k] * 3;
+            mesh_box_merge(box, (f32[6]){p[0], p[1], p[2], p[0], p[1], p[2]});
+        }
+        for (u32 axis = 0; axis < 3; ++axis) {
+            build.centroids[(u64)i * 3 + axis] = 0.5f * (box[axis] + box[axis + 3]);
+        }
+        build.order[i] = i;
+    }
+
+    // the count splits below max_sah_depth add up to ceil(log2(count)) levels
+    u32 count_split_depth = 0;
+    while (count_split_depth < 32 && (1ull << count_split_depth) < count) {
+        ++count_split_depth;
+    }
+    build.max_sah_depth = MIN(MESH_MAX_SAH_DEPTH, MESH_STACK_SIZE - 1 - count_split_depth);
+
+    build_mesh_node(&build, 0, count, 1);
+    // the leaves address the triangles by position, the index buffer is put in leaf order below
+    u32* indices = build.depth <= MESH_STACK_SIZE ? zmemory_allocate((u64)count * 3 * sizeof(u32)) : 0;
+    if (indices == 0) {
+        if (build.depth > MESH_STACK_SIZE) {
+            LOGE("triangle_mesh_build: bvh is too deep (%u levels)", build.depth);
+        } else {
+            LOGE("triangle_mesh_build: out of memory for %u triangles", count);
+        }
+        zmemory_free(mesh->nodes, (u64)capacity * sizeof(triangle_mesh_node));
+        mesh->nodes = 0;
+        mesh_build_free(&build, count);
+        return false;
+    }
+    mesh->node_count = build.node_count;
+    if (mesh->node_count < capacity) {
+        mesh->nodes = zmemory_reallocate(mesh->nodes, (u64)mesh->node_count * sizeof(triangle_mesh_node),
+                                         (u64)capacity * sizeof(triangle_mesh_node));
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        zmemory_copy(indices + (u64)i * 3, mesh->indices + (u64)build.order[i] * 3, 3 * sizeof(u32));
+    }
+    zmemory_free(mesh->indices, (u64)count * 3 * sizeof(u32));
+    mesh->indices = indices;
+
+    const f32(*bounds)[3] = mesh->nodes[0].bounds;
+    mesh->base.box = aabb_create((point3){bounds[0][0], bounds[0][1], bounds[0][2]}, (point3){bounds[1][0], bounds[1][1], bounds[1][2]});
+
+    mesh_build_free(&build, count);
+    return true;
+}
+
+void triangle_mesh_destroy(triangle_mesh* mesh) {
+    if (mesh == 0) {
+        LOGE("triangle_mesh_destroy: invalid params");
+        return;
+    }
+    // a mesh triangle_mesh_allocate ran out of memory for is only partly allocated
+    if (mesh->positions) {
+        zmemory_free(mesh->positions, (u64)mesh->vertex_count * 3 * sizeof(f32));
+    }
+    if (mesh->normals) {
+        zmemory_free(mesh->normals, (u64)mesh->vertex_count * 3 * sizeof(f32));
+    }
+    if (mesh->uvs) {
+        zmemory_free(mesh->uvs, (u64)mesh->vertex_count * 2 * sizeof(f32));
+    }
+    if (mesh->indices) {
+        zmemory_free(mesh->indices, (u64)mesh->triangle_count * 3 * sizeof(u32));
+    }
+    if (mesh->nodes) {
+        zmemory_free(mesh->nodes, (u64)mesh->node_count * sizeof(triangle_mesh_node));
+    }
+    zmemory_free(mesh, sizeof(triangle_mesh));
+}
+
+/// occlusion = true is the any hit test: the first triangle hit returns and the children are not ordered
+INLINE bool triangle_mesh_traverse(triangle_mesh* mesh, ray* r_in, interval r_t, bool occlusion,
+                                   f64* out_t, u32* out_triangle, f64* out_b1, f64* out_b2) {
+    f64 origin[3] = {r_in->origin.x, r_in->origin.y, r_in->origin.z};
+    f64 dir[3] = {r_in->direction.x, r_in->direction.y, r_in->direction.z};
+    f64 inv_dir[3] = {r_in->inv_direction.x, r_in->inv_direction.y, r_in->inv_direction.z};
+    const i32* sign = r_in->sign;
+
+    // watertight test (woop et al. 2013): shear the triangles so the ray goes down +z from the origin,
+    // then the hit is a 2d edge test, the largest direction axis becomes z so the shear is well conditioned
+    i32 kz = zfabs(dir[0]) > zfabs(dir[1]) ? (zfabs(dir[0]) > zfabs(dir[2]) ? 0 : 2) : (zfabs(dir[1]) > zfabs(dir[2]) ? 1 : 2);
+    i32 kx = (kz + 1) % 3;
+    i32 ky = (kx + 1) % 3;
+    if (dir[kz] < 0.0) {
+        i32 swap = kx;
+        kx = ky;
+        ky = swap;
+    }
+    f64 shear_x = dir[kx] / dir[kz];
+    f64 shear_y = dir[ky] / dir[kz];
+    f64 shear_z = 1.0 / dir[kz];
+
+    // only the closest triangle and its barycentrics are kept, the surface is interpolated by triangle_mesh_surface
+    u32 hit_triangle = 0;
+    bool hit_anything = false;
+    f64 hit_b1 = 0.0;
+    f64 hit_b2 = 0.0;
+
+    u32 stack[MESH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 current = 0;
+    for (;;) {
+        triangle_mesh_node* node = mesh->nodes + current;
+
+        f64 tx_near = (node->bounds[sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 tx_far = (node->bounds[1 - sign[0]][0] - origin[0]) * inv_dir[0];
+        f64 ty_near = (node->bounds[sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 ty_far = (node->bounds[1 - sign[1]][1] - origin[1]) * inv_dir[1];
+        f64 tz_near = (node->bounds[sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 tz_far = (node->bounds[1 - sign[2]][2] - origin[2]) * inv_dir[2];
+        f64 t_min = MAX(MAX(tx_near, ty_near), MAX(tz_near, r_t.min));
+        f64 t_max = MIN(MIN(tx_far, ty_far), tz_far) * MESH_SLAB_PAD;
+        t_max = MIN(t_max, r_t.max);
+
+        if (t_min <= t_max) {
+            if (node->triangle_count != 0) {
+                for (u32 i = node->offset; i < node->offset + node->triangle_count; ++i) {
+                    const u32* tri = mesh->indices + (u64)i * 3;
+                    const f32* p0 = mesh->positions + (u64)tri[0] * 3;
+                    const f32* p1 = mesh->positions + (u64)tri[1] * 3;
+                    const f32* p2 = mesh->positions + (u64)tri[2] * 3;
+                    f64 a[3] = {p0[0] - origin[0], p0[1] - origin[1], p0[2] - origin[2]};
+                    f64 b[3] = {p1[0] - origin[0], p1[1] - origin[1], p1[2] - origin[2]};
+                    f64 c[3] = {p2[0] - origin[0], p2[1] - origin[1], p2[2] - origin[2]};
+                    f64 ax = a[kx] - shear_x * a[kz];
+                    f64 ay = a[ky] - shear_y * a[kz];
+                    f64 bx = b[kx] - shear_x * b[kz];
+                    f64 by = b[ky] - shear_y * b[kz];
+                    f64 cx = c[kx] - shear_x * c[kz];
+                    f64 cy = c[ky] - shear_y * c[kz];
+
+                    // scaled barycentrics, the ray is inside when all three have the same sign
+                    f64 u = cx * by - cy * bx;
+                    f64 v = ax * cy - ay * cx;
+                    f64 w = bx * ay - by * ax;
+                    if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0)) {
+                        continue;
+                    }
+                    f64 det = u + v + w;
+                    if (det == 0.0) {
+                        continue; // parallel to the ray or degenerate
+                    }
+                    f64 t = (u * a[kz] + v * b[kz] + w * c[kz]) * shear_z / det;
+                    if (!interval_surrounds(r_t, t)) {
+                        continue;
+                    }
+                    if (occlusion) {
+                        return true;
+                    }
+                    r_t.max = t;
+                    hit_anything = true;
+                    hit_triangle = i;
+                    hit_b1 = v / det;
+                    hit_b2 = w / det;
+                }
+            } else {
+                // visit the child on the ray's side of the split first, the far one waits on the stack
+                // (any order for occlusion)
+                if (occlusion || !sign[node->axis]) {
+                    stack[stack_size++] = node->offset;
+                    current = current + 1;
+                } else {
+                    stack[stack_size++] = current + 1;
+                    current = node->offset;
+                }
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+    *out_t = r_t.max;
+    *out_triangle = hit_triangle;
+    *out_b1 = hit_b1;
+    *out_b2 = hit_b2;
+    return hit_anything;
+}
+
+bool triangle_mesh_hit(hittable* mesh_object, ray* r_in, interval r_t, hit_record* out_record) {
+    f64 t;
+    u32 triangle;
+    f64 b1;
+    f64 b2;
+    if (!triangle_mesh_traverse((triangle_mesh*)mesh_object, r_in, r_t, false, &t, &triangle, &b1, &b2)) {
+        return false;
+    }
+    hit_record_set_hit(out_record, mesh_object, t);
+    out_record->primitive_id = triangle;
+    out_record->b1 = b1;
+    out_record->b2 = b2;
+    return true;
+}
+
+bool triangle_mesh_occluded(hittable* mesh_object, ray* r_in, interval r_t) {
+    f64 t;
+    u32 triangle;
+    f64 b1;
+    f64 b2;
+    return triangle_mesh_traverse((triangle_mesh*)mesh_object, r_in, r_t, true, &t, &triangle, &b1, &b2);
+}
+
+void triangle_mesh_surface(hittable* mesh_object, ray* r_in, hit_record* record) {
+    triangle_mesh* mesh = (triangle_mesh*)mesh_object;
+    f64 hit_b1 = record->b1;
+    f64 hit_b2 = record->b2;
+    f64 hit_b0 = 1.0 - hit_b1 - hit_b2;
+    const u32* tri = mesh->indices + (u64)record->primitive_id * 3;
+    const f32* p0 = mesh->positions + (u64)tri[0] * 3;
+    const f32* p1 = mesh->positions + (u64)tri[1] * 3;
+    const f32* p2 = mesh->positions + (u64)tri[2] * 3;
+    record->point = (point3){
+        hit_b0 * p0[0] + hit_b1 * p1[0] + hit_b2 * p2[0],
+        hit_b0 * p0[1] + hit_b1 * p1[1] + hit_b2 * p2[1],
+        hit_b0 * p0[2] + hit_b1 * p1[2] + hit_b2 * p2[2],
+    };
+    record->mat = mesh->mat;
+
+    vec3 normal;
+    if (mesh->normals) {
+        const f32* n0 = mesh->normals + (u64)tri[0] * 3;
+        const f32* n1 = mesh->normals + (u64)tri[1] * 3;
+        const f32* n2 = mesh->normals + (u64)tri[2] * 3;
+        normal = vec3_unit((vec3){
+            hit_b0 * n0[0] + hit_b1 * n1[0] + hit_b2 * n2[0],
+            hit_b0 * n0[1] + hit_b1 * n1[1] + hit_b2 * n2[1],
+            hit_b0 * n0[2] + hit_b1 * n1[2] + hit_b2 * n2[2],
+        });
+    } else {
+        vec3 edge1 = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        vec3 edge2 = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        normal = vec3_unit(vec3_cross(edge1, edge2));
+    }
+    hit_record_set_face_normal(record, r_in, normal);
+
+    if (mesh->uvs) {
+        const f32* uv0 = mesh->uvs + (u64)tri[0] * 2;
+        const f32* uv1 = mesh->uvs + (u64)tri[1] * 2;
+        const f32* uv2 = mesh->uvs + (u64)tri[2] * 2;
+        record->u = hit_b0 * uv0[0] + hit_b1 * uv1[0] + hit_b2 * uv2[0];
+        record->v = hit_b0 * uv0[1] + hit_b1 * uv1[1] + hit_b2 * uv2[1];
+    } else {
+        record->u = hit_b1;
+        record->v = hit_b2;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+//  __                  __                                          //
+// /  |                /  |                                         //
+// $$ |____    ______  $$ |  ______    ______    ______    _______  //
+// $$      \  /      \ $$ | /      \  /      \  /      \  /       | //
+// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  |/$$$$$$$/  //
+// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/ $$      \  //
+// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       $$$$$$  | //
+// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |      /     $$/  //
+// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/       $$$$$$$/   //
+//                         $$ |                                     //
+//                         $$ |                                     //
+//                         $$/                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+u32 build_mesh_node(mesh_build* build, u32 start, u32 end, u32 depth) {
+    u32 index = build->node_count++;
+    triangle_mesh_node* node = build->mesh->nodes + index;
+    build->depth = MAX(build->depth, depth);
+
+    f32 centroid_box[6];
+    mesh_box_empty(node->bounds[0]);
+    mesh_box_empty(centroid_box);
+    for (u32 i = start; i < end; ++i) {
+        u32 tri = build->order[i];
+        const f32* c = build->centroids + (u64)tri * 3;
+        mesh_box_merge(node->bounds[0], build->boxes + (u64)tri * 6);
+        mesh_box_merge(centroid_box, (f32[6]){c[0], c[1], c[2], c[0], c[1], c[2]});
+    }
+
+    u32 count = end - start;
+    if (count == 1) {
+        node->offset = start;
+        node->triangle_count = 1;
+        return index;
+    }
+
+    // binned sah, same as bvh_create_sah but on the triangle bounds
+    f64 inv_area = 1.0 / mesh_box_area(node->bounds[0]);
+    f64 best_cost = INFINITY;
+    i32 best_axis = -1;
+    u32 best_split = 0;
+    for (i32 axis = 0; axis < 3 && depth <= build->max_sah_depth; ++axis) {
+        f64 extent = centroid_box[axis + 3] - centroid_box[axis];
+        if (!(extent > 0.0)) {
+            continue;
+        }
+        f64 bin_scale = MESH_BIN_COUNT / extent;
+        mesh_bin bins[MESH_BIN_COUNT];
+        for (u32 b = 0; b < MESH_BIN_COUNT; ++b) {
+            mesh_box_empty(bins[b].box);
+            bins[b].count = 0;
+        }
+        for (u32 i = start; i < end; ++i) {
+            u32 tri = build->order[i];
+            i32 b = (i32)((build->centroids[(u64)tri * 3 + axis] - centroid_box[axis]) * bin_scale);
+            b = CLAMP(0, MESH_BIN_COUNT - 1, b);
+            bins[b].count++;
+            mesh_box_merge(bins[b].box, build->boxes + (u64)tri * 6);
+        }
+
+        f64 right_cost[MESH_BIN_COUNT];
+        f32 right_box[6];
+        mesh_box_empty(right_box);
+        u32 right_count = 0;
+        for (u32 b = MESH_BIN_COUNT - 1; b > 0; --b) {
+            mesh_box_merge(right_box, bins[b].box);
+            right_count += bins[b].count;
+            right_cost[b] = right_count * mesh_box_area(right_box);
+        }
+        f32 left_box[6];
+        mesh_box_empty(left_box);
+        u32 left_count = 0;
+        for (u32 b = 0; b < MESH_BIN_COUNT - 1; ++b) {
+            mesh_box_merge(left_box, bins[b].box);
+            left_count += bins[b].count;
+            if (left_count == 0 || left_count == count) {
+                continue;
+            }
+            f64 cost = MESH_TRAVERSAL_COST +
+                       (left_count * mesh_box_area(left_box) + right_cost[b + 1]) * inv_area * MESH_INTERSECTION_COST;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    if (count <= MESH_MAX_LEAF_SIZE && (best_axis < 0 || count * MESH_INTERSECTION_COST <= best_cost)) {
+        node->offset = start;
+        node->triangle_count = count;
+        return index;
+    }
+
+    u32 mid = start;
+    if (best_axis < 0) {
+        // too deep or every centroid on one point, split by count
+        best_axis = 0;
+        mid = start + count / 2;
+    } else {
+        f64 bin_scale = MESH_BIN_COUNT / (centroid_box[best_axis + 3] - centroid_box[best_axis]);
+        for (u32 i = start; i < end; ++i) {
+            u32 tri = build->order[i];
+            i32 b = (i32)((build->centroids[(u64)tri * 3 + best_axis] - centroid_box[best_axis]) * bin_scale);
+            b = CLAMP(0, MESH_BIN_COUNT - 1, b);
+            if ((u32)b < best_split) {
+                build->order[i] = build->order[mid];
+                build->order[mid++] = tri;
+            }
+        }
+    }
+
+    node->axis = best_axis;
+    build_mesh_node(build, start, mid, depth + 1);
+    // the node array doesn't move during the build, it is allocated for the worst case
+    node->offset = build_mesh_node(build, mid, end, depth + 1);
+    return index;
+}
+
+void mesh_build_free(mesh_build* build, u32 count) {
+    if (build->boxes) {
+        zmemory_free(build->boxes, (u64)count * 6 * sizeof(f32));
+    }
+    if (build->centroids) {
+        zmemory_free(build->centroids, (u64)count * 3 * sizeof(f32));
+    }
+    if (build->order) {
+        zmemory_free(build->order, (u64)count * sizeof(u32));
+    }
+}
+
+void mesh_box_empty(f32* box) {
+    box[0] = box[1] = box[2] = INFINITY;
+    box[3] = box[4] = box[5] = -INFINITY;
+}
+
+void mesh_box_merge(f32* box, const f32* other) {
+    for (u32 axis = 0; axis < 3; ++axis) {
+        box[axis] = MIN(box[axis], other[axis]);
+        box[axis + 3] = MAX(box[axis + 3], other[axis + 3]);
+    }
+}
+
+f64 mesh_box_area(const f32* box) {
+    f64 dx = box[3] - box[0];
+    f64 dy = box[4] - box[1];
+    f64 dz = box[5] - box[2];
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+}
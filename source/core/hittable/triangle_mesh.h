@@ -0,0 +1,101 @@
+#ifndef TRIANGLE_MESH__H
+#define TRIANGLE_MESH__H
+
+#include "hittable.h"
+
+/**
+ * @brief triangle_mesh is a derived struct from base hittable which owns shared vertex arrays (f32) and an index buffer
+ * it builds its own bvh over the triangles, a triangle costs 12 bytes of indices instead of a whole triangle struct
+ * the intersection is watertight (no cracks between triangles sharing an edge), the shading normal
+ * and uv are interpolated only once for the closest hit
+ */
+
+typedef struct triangle_mesh_node triangle_mesh_node;
+
+typedef struct triangle_mesh {
+    hittable base;
+    material* mat;
+    f32* positions; /// 3 per vertex
+    f32* normals;   /// 3 per vertex, 0 shades with the geometric normal
+    f32* uvs;       /// 2 per vertex, 0 uses the barycentric coordinates
+    u32* indices;   /// 3 per triangle, reordered by the bvh build
+    u32 vertex_count;
+    u32 triangle_count;
+    triangle_mesh_node* nodes;
+    u32 node_count;
+} triangle_mesh;
+
+/**
+ * @brief
+ *
+ * @param mesh_object pointer to starting addr of triangle_mesh{hittable{base},...}
+ * @param r_in ray
+ * @param r_t ray interval
+ * @param out_record details like point, t,normal,u,v, are written into record
+ * @return bool
+ */
+bool triangle_mesh_hit(hittable* mesh_object, ray* r_in, interval r_t, hit_record* out_record);
+
+/**
+ * @brief triangle_mesh_surface interpolates the point, shading normal and uv of the triangle found by triangle_mesh_hit
+ *
+ * @param mesh_object pointer to starting addr of triangle_mesh{hittable{base},...}
+ * @param r_in ray
+ * @param record record filled by triangle_mesh_hit
+ */
+void triangle_mesh_surface(hittable* mesh_object, ray* r_in, hit_record* record);
+
+/**
+ * @brief triangle_mesh_occluded is the any hit test, it stops at the first triangle hit inside r_t
+ *
+ * @param mesh_object pointer to starting addr of triangle_mesh{hittable{base},...}
+ * @param r_in ray
+ * @param r_t ray interval
+ * @return bool
+ */
+bool triangle_mesh_occluded(hittable* mesh_object, ray* r_in, interval r_t);
+
+/**
+ * @brief triangle_mesh_create copies the arrays and builds the bvh
+ *
+ * @param positions 3 floats per vertex
+ * @param normals 3 floats per vertex, can be 0
+ * @param uvs 2 floats per vertex, can be 0
+ * @param vertex_count number of vertices
+ * @param indices 3 vertex indices per triangle
+ * @param triangle_count number of triangles
+ * @param mat material of the whole mesh
+ * @return triangle_mesh*
+ */
+triangle_mesh* triangle_mesh_create(const f32* positions, const f32* normals, const f32* uvs, u32 vertex_count,
+                                    const u32* indices, u32 triangle_count, material* mat);
+
+/**
+ * @brief triangle_mesh_allocate only allocates the arrays so a loader can fill them in place,
+ * call triangle_mesh_build once they are filled
+ *
+ * @param vertex_count number of vertices
+ * @param triangle_count number of triangles
+ * @param has_normals allocate the normals array
+ * @param has_uvs allocate the uvs array
+ * @param mat material of the whole mesh
+ * @return triangle_mesh*
+ */
+triangle_mesh* triangle_mesh_allocate(u32 vertex_count, u32 triangle_count, bool has_normals, bool has_uvs, material* mat);
+
+/**
+ * @brief triangle_mesh_build builds the bvh and the bounds of a filled mesh
+ *
+ * @param mesh mesh from triangle_mesh_allocate
+ * @return bool false if an index is out of range
+ */
+bool triangle_mesh_build(triangle_mesh* mesh);
+
+/**
+ * @brief triangle_mesh_destroy free's the memory allocated
+ *
+ * @param mesh pointer to starting addr of the mesh
+ */
+void triangle_mesh_destroy(triangle_mesh* mesh);
+
+#endif
@@ -1,16 +1,47 @@
 #include "hittable_list.h"
+#include "logger.h"
 
 bool hittable_list_hit(hittable_list* list, ray* r, interval r_t, hit_record* record) {
-    hit_record temp_record;
     bool hit_anything = false;
     f64 closest_so_far = r_t.max;
     i32 size = darray_length(list->objects);
     for (i32 i = 0; i < size; i++) {
-        if (list->objects[i]->hit(list->objects[i], r, (interval){r_t.min, closest_so_far}, &temp_record)) {
+        if (list->objects[i]->hit(list->objects[i], r, (interval){r_t.min, closest_so_far}, record)) {
+            // a hit only writes the record when it is closer than closest_so_far, no copy needed
             hit_anything = true;
-            closest_so_far = temp_record.t;
-            *record = temp_record;
+            closest_so_far = record->t;
         }
     }
     return hit_anything;
-}
\ No newline at end of file
+}
+
+bool hittable_list_occluded(hittable_list* list, ray* r, interval r_t) {
+    i32 size = darray_length(list->objects);
+    for (i32 i = 0; i < size; i++) {
+        if (list->objects[i]->occluded(list->objects[i], r, r_t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void hittable_list_add_light(hittable_list* list, hittable* object) {
+    if (!list || !object || !object->sample || !object->pdf) {
+        LOGE("hittable_list_add_light: invalid params");
+        return;
+    }
+    darray_push_back(list->lights, object);
+}
+
+f64 hittable_list_light_pdf(hittable_list* list, hit_record* record, point3 origin, vec3 direction) {
+    if (record->instance_count != 0) {
+        return 0.0;
+    }
+    i32 size = darray_length(list->lights);
+    for (i32 i = 0; i < size; i++) {
+        if (list->lights[i] == record->object) {
+            return list->lights[i]->pdf(list->lights[i], origin, direction) / size;
+        }
+    }
+    return 0.0;
+}
@@ -8,18 +8,33 @@
 
 typedef struct hittable_list {
     hittable** objects; // darray of hittable pointers
+    hittable** lights;  // darray of the emitters that are sampled directly, they are in objects too
 } hittable_list;
 
 bool hittable_list_hit(hittable_list* list_object, ray* r, interval r_t, hit_record* record);
 
+/// true if any object is hit inside r_t, cheaper than hittable_list_hit for shadow and visibility rays
+bool hittable_list_occluded(hittable_list* list_object, ray* r, interval r_t);
+
+/**
+ * @brief registers an emitter that is already in the world (directly or inside a bvh) for light sampling,
+ * it must be an untransformed sphere, quad, triangle or circle (a hittable with sample and pdf)
+ */
+void hittable_list_add_light(hittable_list* list_object, hittable* object);
+
+/// solid angle pdf of picking direction from origin by light sampling, 0 if the hit in record isn't a registered light
+f64 hittable_list_light_pdf(hittable_list* list_object, hit_record* record, point3 origin, vec3 direction);
+
 INLINE hittable_list* hittable_list_create() {
     hittable_list* list = zmemory_allocate(sizeof(hittable_list));
     list->objects = darray_create(hittable*);
+    list->lights = darray_create(hittable*);
     return list;
 }
 
 INLINE void hittable_list_destroy(hittable_list* list) {
     darray_destroy(list->objects);
+    darray_destroy(list->lights);
     zmemory_free(list, sizeof(hittable_list));
 }
 
@@ -25,6 +25,10 @@ typedef struct material material;
 struct material {
     color (*emitted)(material* mat, hit_record* record);
     bool (*scatter)(material* mat, ray* r_in, hit_record* record, color* out_attenuation, ray* out_scattered);
+    /// bsdf * cos toward direction (picked by light sampling) and the pdf scatter picks direction with,
+    /// materials with a delta bsdf (mirror, glass) or no bsdf (light) give 0 and are never light sampled
+    color (*eval)(material* mat, ray* r_in, hit_record* record, vec3 direction, f64* out_pdf);
+    bool light_sampled; /// eval can be nonzero, the other materials skip light sampling (and its shadow ray) entirely
 };
 
 INLINE color default_emitted(material* mat, hit_record* record) {
@@ -33,6 +37,10 @@ INLINE color default_emitted(material* mat, hit_record* record) {
 INLINE bool default_scatter(material* mat, ray* r_in, hit_record* record, color* out_attenuation, ray* out_scattered) {
     return false;
 }
+INLINE color default_eval(material* mat, ray* r_in, hit_record* record, vec3 direction, f64* out_pdf) {
+    *out_pdf = 0.0;
+    return (color){0.0, 0.0, 0.0};
+}
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //  __                          __                              __      __                      //
@@ -53,29 +61,43 @@ typedef struct lambertian {
     color abledo;
 } lambertian;
 
+INLINE color lambertian_albedo(lambertian* lamb, hit_record* record) {
+    if (lamb->tex) {
+        return vec3_mul(lamb->tex->value(lamb->tex, record->point, record->u, record->v), lamb->abledo);
+    }
+    return lamb->abledo;
+}
+
 INLINE bool lambertian_scatter(material* mat, ray* r_in, hit_record* record, color* out_attenuation, ray* out_scattered) {
     lambertian* lamb = (lambertian*)mat;
     vec3 scatter_direction = vec3_add(record->normal, vec3_random_unit_vector());
     if (vec3_compare(scatter_direction, (vec3){0.0, 0.0, 0.0})) {
         scatter_direction = record->normal;
     }
-    *out_scattered = (ray){
-        .origin = record->point,
-        .direction = scatter_direction,
-    };
-    if (lamb->tex) {
-        *out_attenuation = vec3_mul(lamb->tex->value(lamb->tex, record->point, record->u, record->v), lamb->abledo);
-    } else {
-        *out_attenuation = lamb->abledo;
-    }
+    *out_scattered = ray_create(record->point, scatter_direction);
+    *out_attenuation = lambertian_albedo(lamb, record);
     return true;
 }
 
+/// normal + random unit vector picks directions with pdf cos / pi, the bsdf is albedo / pi
+INLINE color lambertian_eval(material* mat, ray* r_in, hit_record* record, vec3 direction, f64* out_pdf) {
+    lambertian* lamb = (lambertian*)mat;
+    f64 cosine = vec3_dot(record->normal, vec3_unit(direction));
+    if (cosine <= 0.0) {
+        *out_pdf = 0.0;
+        return (color){0.0, 0.0, 0.0};
+    }
+    *out_pdf = cosine / PI;
+    return vec3_mul_scalar(cosine / PI, lambertian_albedo(lamb, record));
+}
+
 INLINE lambertian lambertian_create(color albedo, texture* tex) {
     return (lambertian){
         .base = {
             .emitted = default_emitted,
             .scatter = lambertian_scatter,
+            .eval = lambertian_eval,
+            .light_sampled = true,
         },
         .tex = tex,
         .abledo = albedo,
@@ -108,10 +130,7 @@ INLINE bool metal_scatter(material* mat, ray* r_in, hit_record* record, vec3* ou
     if (mtal->fuzz > DBL_EPSILON) {
         reflected = vec3_add(reflected, vec3_mul_scalar(mtal->fuzz, vec3_random_unit_vector()));
     }
-    *out_scattered = (ray){
-        .origin = record->point,
-        .direction = reflected,
-    };
+    *out_scattered = ray_create(record->point, reflected);
     if (mtal->tex) {
         *out_attenuation = vec3_mul(mtal->albedo, mtal->tex->value(mtal->tex, record->point, record->u, record->v));
     } else {
@@ -125,6 +144,7 @@ INLINE metal metal_create(color albedo, texture* tex, f64 fuzz) {
         .base = {
             .emitted = default_emitted,
             .scatter = metal_scatter,
+            .eval = default_eval,
         },
         .albedo = albedo,
         .tex = tex,
@@ -169,10 +189,7 @@ INLINE bool dielectric_scatter(material* mat, ray* r_in, hit_record* record, vec
         dir = vec3_refract(unit, record->normal, ri);
     }
 
-    *out_scattered = (ray){
-        .origin = record->point,
-        .direction = dir,
-    };
+    *out_scattered = ray_create(record->point, dir);
 
     if (diele->tex) {
         *out_attenuation = vec3_mul(diele->albedo, diele->tex->value(diele->tex, record->point, record->u, record->v));
@@ -187,6 +204,7 @@ INLINE dielectric dielectric_create(color albedo, texture* tex, f64 refraction_i
         .base = {
             .emitted = default_emitted,
             .scatter = dielectric_scatter,
+            .eval = default_eval,
         },
         .albedo = albedo,
         .tex = tex,
@@ -229,6 +247,7 @@ INLINE diffuse_light diffuse_light_create(color albedo, texture* tex) {
         .base = {
             .emitted = diffuse_light_emmitted,
             .scatter = default_scatter,
+            .eval = default_eval,
         },
         .albedo = albedo,
         .tex = tex,
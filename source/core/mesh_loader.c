@@ -0,0 +1,1032 @@
+#include "mesh_loader.h"
+#include "platform.h"
+#include "zmemory.h"
+#include "logger.h"
+#include <string.h>
+#include <stdlib.h>
+
+// bytes of text (obj) or records (ply) per job, small files are loaded by a single job
+#define MESH_LOADER_CHUNK_SIZE (1u << 20)
+#define OBJ_NO_INDEX 0xffffffffu
+#define PLY_MAX_ELEMENTS 16
+#define PLY_MAX_PROPERTIES 32
+#define PLY_MAX_NAME 32
+#define PLY_ATTRIBUTE_COUNT 8 // x y z nx ny nz u v
+
+typedef struct obj_loader obj_loader;
+
+typedef struct obj_chunk {
+    obj_loader* loader;
+    const u8* begin; // the chunk always starts at the beginning of a line
+    const u8* end;
+    // counted by the first pass, then turned into the first slot of this chunk in every array
+    u32 positions;
+    u32 normals;
+    u32 uvs;
+    u32 triangles;
+    u32 triangles_end;
+    bool matched; // every corner uses the same index for its position, normal and uv
+    bool failed;
+} obj_chunk;
+
+typedef struct obj_corner {
+    u32 position;
+    u32 normal;
+    u32 uv;
+} obj_corner;
+
+struct obj_loader {
+    triangle_mesh* mesh;
+    triangle_mesh* unwelded;
+    f32* normals;        // mesh->normals when they line up with the positions, a temporary array otherwise
+    f32* uvs;            // same as normals
+    u32* corner_normals; // normal and uv index of every triangle corner, only when the mesh gets unwelded
+    u32* corner_uvs;
+    u32 position_count;
+    u32 normal_count;
+    u32 uv_count;
+    u32 triangle_count;
+};
+
+typedef enum ply_type {
+    PLY_TYPE_NONE,
+    PLY_TYPE_I8,
+    PLY_TYPE_U8,
+    PLY_TYPE_I16,
+    PLY_TYPE_U16,
+    PLY_TYPE_I32,
+    PLY_TYPE_U32,
+    PLY_TYPE_F32,
+    PLY_TYPE_F64,
+} ply_type;
+
+typedef struct ply_property {
+    char name[PLY_MAX_NAME];
+    ply_type type;       // item type of lists
+    ply_type count_type; // PLY_TYPE_NONE unless the property is a list
+    u32 offset;          // in the record, for fixed size records and for faces that are all triangles
+} ply_property;
+
+typedef struct ply_element {
+    char name[PLY_MAX_NAME];
+    u64 count;
+    ply_property properties[PLY_MAX_PROPERTIES];
+    u32 property_count;
+    u32 list_count;
+    u32 stride; // record size, with lists of 3 items when the element has lists
+} ply_element;
+
+typedef struct ply_loader {
+    triangle_mesh* mesh;
+    bool big_endian;
+    const u8* vertices;
+    const u8* faces;
+    u32 vertex_stride;
+    u32 face_stride;
+    const ply_property* attributes[PLY_ATTRIBUTE_COUNT]; // 0 for the missing ones
+    const ply_property* face_indices;
+} ply_loader;
+
+typedef struct ply_chunk {
+    ply_loader* loader;
+    u32 start;
+    u32 end;
+    bool failed;
+} ply_chunk;
+
+triangle_mesh* obj_load(const platform_file_mapping* file, material* mat, zthread_pool* pool);
+triangle_mesh* ply_load(const platform_file_mapping* file, material* mat, zthread_pool* pool);
+bool mesh_loader_has_extension(const char* file_path, const char* extension);
+void obj_count_job(void* params);
+void obj_parse_job(void* params);
+void obj_unweld_job(void* params);
+void obj_loader_free(obj_loader* loader);
+bool ply_parse_header(const platform_file_mapping* file, ply_element* elements, u32* out_element_count, bool* out_big_endian, u64* out_body_offset);
+bool ply_walk(const ply_element* element, const ply_property* indices, bool big_endian, const u8** cursor, const u8* end,
+              u32* out_indices, u32 vertex_count, u64* out_triangle_count);
+ply_chunk* ply_chunks_create(ply_loader* loader, u64 count, u32 stride, u32* out_chunk_count);
+void ply_check_faces_job(void* params);
+void ply_vertex_job(void* params);
+void ply_face_job(void* params);
+
+triangle_mesh* mesh_load(const char* file_path, material* mat, zthread_pool* pool) {
+    if (file_path == 0) {
+        LOGE("mesh_load: invalid params");
+        return 0;
+    }
+    bool is_obj = mesh_loader_has_extension(file_path, "obj");
+    if (!is_obj && !mesh_loader_has_extension(file_path, "ply")) {
+        LOGE("mesh_load: %s is not an obj or ply file", file_path);
+        return 0;
+    }
+    platform_file_mapping file;
+    if (!platform_file_map(file_path, &file)) {
+        return 0;
+    }
+
+    // the pages are read from the disk as the parser touches them, so the timing includes the io
+    f64 start_time = platform_time();
+    triangle_mesh* mesh = is_obj ? obj_load(&file, mat, pool) : ply_load(&file, mat, pool);
+    f64 parse_time = platform_time() - start_time;
+    u64 file_size = file.size;
+    platform_file_unmap(&file);
+    if (mesh == 0) {
+        LOGE("mesh_load: failed to load %s", file_path);
+        return 0;
+    }
+
+    start_time = platform_time();
+    if (!triangle_mesh_build(mesh)) {
+        LOGE("mesh_load: failed to load %s", file_path);
+        triangle_mesh_destroy(mesh);
+        return 0;
+    }
+    f64 build_time = platform_time() - start_time;
+
+    f64 seconds = MAX(parse_time, 1e-6);
+    LOGI("mesh_load: %s, %.1f MB, %u triangles parsed in %.3f s (%.1f MB/s, %.2f M triangles/s), bvh built in %.3f s",
+         file_path, file_size / 1e6, mesh->triangle_count, parse_time, file_size / 1e6 / seconds,
+         mesh->triangle_count / 1e6 / seconds, build_time);
+    return mesh;
+}
+
+triangle_mesh* obj_load(const platform_file_mapping* file, material* mat, zthread_pool* pool) {
+    obj_loader loader = {0};
+
+    // cut the text into chunks that end right after a line break
+    u32 chunk_capacity = (u32)(file->size / MESH_LOADER_CHUNK_SIZE) + 1;
+    obj_chunk* chunks = zmemory_allocate(chunk_capacity * sizeof(obj_chunk));
+    if (chunks == 0) {
+        LOGE("obj_load: out of memory");
+        return 0;
+    }
+    u32 chunk_count = 0;
+    const u8* file_end = file->data + file->size;
+    for (const u8* begin = file->data; begin < file_end;) {
+        const u8* end = begin + MIN((u64)(file_end - begin), MESH_LOADER_CHUNK_SIZE);
+        while (end < file_end && end[-1] != '\n') {
+            end++;
+        }
+        chunks[chunk_count++] = (obj_chunk){.loader = &loader, .begin = begin, .end = end};
+        begin = end;
+    }
+
+    zthread_pool_parallel_for(pool, chunks, sizeof(obj_chunk), chunk_count, obj_count_job);
+    u64 positions = 0;
+    u64 normals = 0;
+    u64 uvs = 0;
+    u64 triangles = 0;
+    for (u32 i = 0; i < chunk_count; ++i) {
+        obj_chunk* chunk = chunks + i;
+        u64 counts[4] = {chunk->positions, chunk->normals, chunk->uvs, chunk->triangles};
+        chunk->positions = (u32)positions;
+        chunk->normals = (u32)normals;
+        chunk->uvs = (u32)uvs;
+        chunk->triangles = (u32)triangles;
+        positions += counts[0];
+        normals += counts[1];
+        uvs += counts[2];
+        triangles += counts[3];
+        chunk->triangles_end = (u32)triangles;
+    }
+    if (positions == 0 || triangles == 0 || positions > 0xffffffffu || normals > 0xffffffffu || uvs > 0xffffffffu ||
+        triangles > 0xffffffffu / 3) {
+        LOGE("obj_load: %llu vertices and %llu triangles can't be loaded", positions, triangles);
+        zmemory_free(chunks, chunk_capacity * sizeof(obj_chunk));
+        return 0;
+    }
+    loader.position_count = positions;
+    loader.normal_count = normals;
+    loader.uv_count = uvs;
+    loader.triangle_count = triangles;
+
+    // normals and uvs are only written into the mesh directly when there is one per position,
+    // if the corners turn out to use other indices than their position the file is parsed again to unweld
+    bool welded = (normals == 0 || normals == positions) && (uvs == 0 || uvs == positions);
+    for (u32 pass = 0; pass < 2; ++pass) {
+        if (welded) {
+            loader.mesh = triangle_mesh_allocate(positions, triangles, normals != 0, uvs != 0, mat);
+            loader.normals = loader.mesh ? loader.mesh->normals : 0;
+            loader.uvs = loader.mesh ? loader.mesh->uvs : 0;
+        } else {
+            loader.mesh = triangle_mesh_allocate(positions, triangles, false, false, mat);
+            loader.normals = normals ? zmemory_allocate(normals * 3 * sizeof(f32)) : 0;
+            loader.uvs = uvs ? zmemory_allocate(uvs * 2 * sizeof(f32)) : 0;
+            loader.corner_normals = normals ? zmemory_allocate(triangles * 3 * sizeof(u32)) : 0;
+            loader.corner_uvs = uvs ? zmemory_allocate(triangles * 3 * sizeof(u32)) : 0;
+        }
+        if (loader.mesh == 0 || (normals && (loader.normals == 0 || (!welded && loader.corner_normals == 0))) ||
+            (uvs && (loader.uvs == 0 || (!welded && loader.corner_uvs == 0)))) {
+            LOGE("obj_load: out of memory for %llu vertices and %llu triangles", positions, triangles);
+            obj_loader_free(&loader);
+            if (loader.mesh) {
+                triangle_mesh_destroy(loader.mesh);
+            }
+            zmemory_free(chunks, chunk_capacity * sizeof(obj_chunk));
+            return 0;
+        }
+
+        zthread_pool_parallel_for(pool, chunks, sizeof(obj_chunk), chunk_count, obj_parse_job);
+        bool failed = false;
+        bool matched = true;
+        for (u32 i = 0; i < chunk_count; ++i) {
+            failed |= chunks[i].failed;
+            matched &= chunks[i].matched;
+        }
+        if (failed) {
+            LOGE("obj_load: a face has a missing or out of range index");
+            obj_loader_free(&loader);
+            triangle_mesh_destroy(loader.mesh);
+            zmemory_free(chunks, chunk_capacity * sizeof(obj_chunk));
+            return 0;
+        }
+        if (welded && matched) {
+            break;
+        }
+        if (welded) {
+            triangle_mesh_destroy(loader.mesh);
+            welded = false;
+            continue;
+        }
+
+        // one vertex per corner
+        loader.unwelded = triangle_mesh_allocate(triangles * 3, triangles, normals != 0, uvs != 0, mat);
+        if (loader.unwelded == 0) {
+            LOGE("obj_load: out of memory to unweld %llu triangles", triangles);
+            obj_loader_free(&loader);
+            triangle_mesh_destroy(loader.mesh);
+            zmemory_free(chunks, chunk_capacity * sizeof(obj_chunk));
+            return 0;
+        }
+        zthread_pool_parallel_for(pool, chunks, sizeof(obj_chunk), chunk_count, obj_unweld_job);
+        obj_loader_free(&loader);
+        triangle_mesh_destroy(loader.mesh);
+        loader.mesh = loader.unwelded;
+        break;
+    }
+
+    zmemory_free(chunks, chunk_capacity * sizeof(obj_chunk));
+    return loader.mesh;
+}
+
+triangle_mesh* ply_load(const platform_file_mapping* file, material* mat, zthread_pool* pool) {
+    ply_element* elements = zmemory_allocate(PLY_MAX_ELEMENTS * sizeof(ply_element));
+    if (elements == 0) {
+        LOGE("ply_load: out of memory");
+        return 0;
+    }
+    u32 element_count = 0;
+    ply_loader loader = {0};
+    u64 body_offset = 0;
+    if (!ply_parse_header(file, elements, &element_count, &loader.big_endian, &body_offset)) {
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        return 0;
+    }
+
+    const ply_element* vertex = 0;
+    const ply_element* face = 0;
+    for (u32 i = 0; i < element_count; ++i) {
+        if (strcmp(elements[i].name, "vertex") == 0) {
+            vertex = elements + i;
+        } else if (strcmp(elements[i].name, "face") == 0) {
+            face = elements + i;
+        }
+    }
+    if (vertex == 0 || face == 0 || vertex->list_count != 0 || vertex->count == 0 || vertex->count > 0xffffffffu) {
+        LOGE("ply_load: the file needs a vertex element without lists and a face element");
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        return 0;
+    }
+
+    const char* attribute_names[PLY_ATTRIBUTE_COUNT][3] = {
+        {"x"}, {"y"}, {"z"}, {"nx"}, {"ny"}, {"nz"}, {"u", "s", "texture_u"}, {"v", "t", "texture_v"},
+    };
+    for (u32 a = 0; a < PLY_ATTRIBUTE_COUNT; ++a) {
+        for (u32 p = 0; p < vertex->property_count; ++p) {
+            for (u32 n = 0; n < 3 && attribute_names[a][n]; ++n) {
+                if (strcmp(vertex->properties[p].name, attribute_names[a][n]) == 0) {
+                    loader.attributes[a] = vertex->properties + p;
+                }
+            }
+        }
+    }
+    for (u32 p = 0; p < face->property_count; ++p) {
+        const ply_property* property = face->properties + p;
+        if (property->count_type != PLY_TYPE_NONE &&
+            (strcmp(property->name, "vertex_indices") == 0 || strcmp(property->name, "vertex_index") == 0)) {
+            loader.face_indices = property;
+        }
+    }
+    if (!loader.attributes[0] || !loader.attributes[1] || !loader.attributes[2] || !loader.face_indices) {
+        LOGE("ply_load: the file needs x, y, z vertex properties and a vertex_indices face list");
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        return 0;
+    }
+    bool has_normals = loader.attributes[3] && loader.attributes[4] && loader.attributes[5];
+    bool has_uvs = loader.attributes[6] && loader.attributes[7];
+
+    // find where the vertex and face records start, the elements are stored one after the other
+    const u8* cursor = file->data + body_offset;
+    const u8* end = file->data + file->size;
+    u64 triangles = 0;
+    bool face_triangles = false; // every face is a triangle, the face records have a fixed size
+    for (u32 i = 0; i < element_count; ++i) {
+        const ply_element* element = elements + i;
+        if (element == face && face->list_count == 1 && face->count != 0 && (u64)(end - cursor) / face->stride >= face->count) {
+            // the faces are most likely all triangles, check it in parallel instead of walking every record
+            loader.faces = cursor;
+            loader.face_stride = face->stride;
+            u32 chunk_count = 0;
+            ply_chunk* chunks = ply_chunks_create(&loader, face->count, face->stride, &chunk_count);
+            if (chunks == 0) {
+                zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+                return 0;
+            }
+            zthread_pool_parallel_for(pool, chunks, sizeof(ply_chunk), chunk_count, ply_check_faces_job);
+            face_triangles = true;
+            for (u32 c = 0; c < chunk_count; ++c) {
+                face_triangles &= !chunks[c].failed;
+            }
+            zmemory_free(chunks, chunk_count * sizeof(ply_chunk));
+            if (face_triangles) {
+                triangles = face->count;
+                cursor += face->count * face->stride;
+                continue;
+            }
+        }
+        if (element->list_count == 0) {
+            if ((u64)(end - cursor) / element->stride < element->count) {
+                cursor = 0;
+                break;
+            }
+            if (element == vertex) {
+                loader.vertices = cursor;
+                loader.vertex_stride = vertex->stride;
+            }
+            cursor += element->count * element->stride;
+            continue;
+        }
+        if (element == face) {
+            loader.faces = cursor;
+        }
+        if (!ply_walk(element, element == face ? loader.face_indices : 0, loader.big_endian, &cursor, end, 0, 0, &triangles)) {
+            cursor = 0;
+            break;
+        }
+    }
+    if (cursor == 0 || loader.vertices == 0 || triangles == 0 || triangles > 0xffffffffu / 3) {
+        LOGE("ply_load: the file is truncated or has no triangles");
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        return 0;
+    }
+
+    loader.mesh = triangle_mesh_allocate(vertex->count, triangles, has_normals, has_uvs, mat);
+    if (loader.mesh == 0) {
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        return 0;
+    }
+    u32 chunk_count = 0;
+    ply_chunk* chunks = ply_chunks_create(&loader, vertex->count, vertex->stride, &chunk_count);
+    if (chunks == 0) {
+        zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+        triangle_mesh_destroy(loader.mesh);
+        return 0;
+    }
+    zthread_pool_parallel_for(pool, chunks, sizeof(ply_chunk), chunk_count, ply_vertex_job);
+    zmemory_free(chunks, chunk_count * sizeof(ply_chunk));
+
+    bool failed = false;
+    if (face_triangles) {
+        chunks = ply_chunks_create(&loader, face->count, face->stride, &chunk_count);
+        if (chunks == 0) {
+            zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+            triangle_mesh_destroy(loader.mesh);
+            return 0;
+        }
+        zthread_pool_parallel_for(pool, chunks, sizeof(ply_chunk), chunk_count, ply_face_job);
+        for (u32 c = 0; c < chunk_count; ++c) {
+            failed |= chunks[c].failed;
+        }
+        zmemory_free(chunks, chunk_count * sizeof(ply_chunk));
+    } else {
+        // polygons, the records have to be walked one after the other to find where each starts
+        cursor = loader.faces;
+        triangles = 0;
+        failed = !ply_walk(face, loader.face_indices, loader.big_endian, &cursor, end, loader.mesh->indices, vertex->count, &triangles);
+    }
+    zmemory_free(elements, PLY_MAX_ELEMENTS * sizeof(ply_element));
+    if (failed) {
+        LOGE("ply_load: a face has an out of range index");
+        triangle_mesh_destroy(loader.mesh);
+        return 0;
+    }
+    return loader.mesh;
+}
+
+//////////////////////////////////////////////////////////////////////
+//  __                  __                                          //
+// /  |                /  |                                         //
+// $$ |____    ______  $$ |  ______    ______    ______    _______  //
+// $$      \  /      \ $$ | /      \  /      \  /      \  /       | //
+// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  |/$$$$$$$/  //
+// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/ $$      \  //
+// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       $$$$$$  | //
+// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |      /     $$/  //
+// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/       $$$$$$$/   //
+//                         $$ |                                     //
+//                         $$ |                                     //
+//                         $$/                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+bool mesh_loader_has_extension(const char* file_path, const char* extension) {
+    const char* dot = strrchr(file_path, '.');
+    if (dot == 0) {
+        return false;
+    }
+    for (++dot; *dot && *extension; ++dot, ++extension) {
+        if ((*dot | 0x20) != *extension) {
+            return false;
+        }
+    }
+    return *dot == 0 && *extension == 0;
+}
+
+INLINE bool obj_is_blank(u8 c) {
+    return c == ' ' || c == '\t';
+}
+
+INLINE bool obj_is_digit(u8 c) {
+    return (u8)(c - '0') < 10;
+}
+
+INLINE const u8* obj_skip_blanks(const u8* cursor, const u8* end) {
+    while (cursor < end && obj_is_blank(*cursor)) {
+        cursor++;
+    }
+    return cursor;
+}
+
+INLINE const u8* obj_next_line(const u8* cursor, const u8* end) {
+    while (cursor < end && *cursor++ != '\n') {
+    }
+    return cursor;
+}
+
+INLINE bool obj_token_ended(const u8* cursor, const u8* end) {
+    return cursor >= end || obj_is_blank(*cursor) || *cursor == '\r' || *cursor == '\n' || *cursor == '#';
+}
+
+// strtod is slow and depends on the locale, this reads the decimal and exponent forms obj files use
+INLINE f32 obj_parse_f32(const u8** cursor, const u8* end) {
+    static const f64 powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const u8* c = obj_skip_blanks(*cursor, end);
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c++ == '-';
+    }
+    // 18 digits fit in the mantissa, the rest only move the exponent
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    for (; c < end && obj_is_digit(*c); ++c) {
+        if (mantissa < 100000000000000000ull) {
+            mantissa = mantissa * 10 + (*c - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (c < end && *c == '.') {
+        for (++c; c < end && obj_is_digit(*c); ++c) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*c - '0');
+                exponent--;
+            }
+        }
+    }
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        ++c;
+        bool negative_exponent = false;
+        if (c < end && (*c == '-' || *c == '+')) {
+            negative_exponent = *c++ == '-';
+        }
+        i32 value = 0;
+        for (; c < end && obj_is_digit(*c); ++c) {
+            value = MIN(value * 10 + (*c - '0'), 10000);
+        }
+        exponent += negative_exponent ? -value : value;
+    }
+    *cursor = c;
+
+    f64 result = (f64)mantissa;
+    if (exponent < 0) {
+        result = -exponent <= 22 ? result / powers_of_ten[-exponent] : result / zpow(10.0, -exponent);
+    } else if (exponent > 0) {
+        result = exponent <= 22 ? result * powers_of_ten[exponent] : result * zpow(10.0, exponent);
+    }
+    return (f32)(negative ? -result : result);
+}
+
+// obj indices start at 1, negative ones count back from the last element defined before the face
+INLINE bool obj_parse_index(const u8** cursor, const u8* end, u32 defined, u32 total, u32* out_index) {
+    const u8* c = *cursor;
+    bool negative = false;
+    if (c < end && *c == '-') {
+        negative = true;
+        c++;
+    }
+    if (c >= end || !obj_is_digit(*c)) {
+        return false;
+    }
+    i64 value = 0;
+    for (; c < end && obj_is_digit(*c); ++c) {
+        value = MIN(value * 10 + (*c - '0'), 0x100000000ll);
+    }
+    *cursor = c;
+    i64 index = negative ? (i64)defined - value : value - 1;
+    if (value == 0 || index < 0 || index >= total) {
+        return false;
+    }
+    *out_index = (u32)index;
+    return true;
+}
+
+// v, v/vt, v//vn or v/vt/vn
+INLINE bool obj_parse_corner(const u8** cursor, const u8* end, obj_chunk* chunk, u32 positions, u32 normals, u32 uvs, obj_corner* out_corner) {
+    obj_loader* loader = chunk->loader;
+    const u8* c = *cursor;
+    out_corner->normal = OBJ_NO_INDEX;
+    out_corner->uv = OBJ_NO_INDEX;
+    if (!obj_parse_index(&c, end, positions, loader->position_count, &out_corner->position)) {
+        return false;
+    }
+    if (c < end && *c == '/') {
+        c++;
+        if (c < end && *c != '/' && !obj_token_ended(c, end) && !obj_parse_index(&c, end, uvs, loader->uv_count, &out_corner->uv)) {
+            return false;
+        }
+        if (c < end && *c == '/') {
+            c++;
+            if (!obj_parse_index(&c, end, normals, loader->normal_count, &out_corner->normal)) {
+                return false;
+            }
+        }
+    }
+    *cursor = c;
+    return obj_token_ended(c, end);
+}
+
+void obj_count_job(void* params) {
+    obj_chunk* chunk = params;
+    const u8* cursor = chunk->begin;
+    const u8* end = chunk->end;
+    u32 positions = 0;
+    u32 normals = 0;
+    u32 uvs = 0;
+    u32 triangles = 0;
+    while (cursor < end) {
+        cursor = obj_skip_blanks(cursor, end);
+        if (cursor + 1 < end && cursor[0] == 'v') {
+            positions += obj_is_blank(cursor[1]);
+            normals += cursor[1] == 'n';
+            uvs += cursor[1] == 't';
+        } else if (cursor + 1 < end && cursor[0] == 'f' && obj_is_blank(cursor[1])) {
+            u32 corners = 0;
+            for (cursor = obj_skip_blanks(cursor + 1, end); !obj_token_ended(cursor, end); cursor = obj_skip_blanks(cursor, end)) {
+                corners++;
+                while (!obj_token_ended(cursor, end)) {
+                    cursor++;
+                }
+            }
+            triangles += corners > 2 ? corners - 2 : 0;
+        }
+        cursor = obj_next_line(cursor, end);
+    }
+    chunk->positions = positions;
+    chunk->normals = normals;
+    chunk->uvs = uvs;
+    chunk->triangles = triangles;
+}
+
+void obj_parse_job(void* params) {
+    obj_chunk* chunk = params;
+    obj_loader* loader = chunk->loader;
+    triangle_mesh* mesh = loader->mesh;
+    const u8* cursor = chunk->begin;
+    const u8* end = chunk->end;
+    // next slot of every array, also the number of elements defined so far in the whole file
+    u32 positions = chunk->positions;
+    u32 normals = chunk->normals;
+    u32 uvs = chunk->uvs;
+    u32 triangles = chunk->triangles;
+    bool matched = true;
+    chunk->failed = false;
+
+    while (cursor < end) {
+        cursor = obj_skip_blanks(cursor, end);
+        if (cursor + 1 < end && cursor[0] == 'v') {
+            if (obj_is_blank(cursor[1])) {
+                cursor += 1;
+                f32* p = mesh->positions + (u64)positions++ * 3;
+                p[0] = obj_parse_f32(&cursor, end);
+                p[1] = obj_parse_f32(&cursor, end);
+                p[2] = obj_parse_f32(&cursor, end);
+            } else if (cursor[1] == 'n') {
+                cursor += 2;
+                f32* n = loader->normals + (u64)normals++ * 3;
+                n[0] = obj_parse_f32(&cursor, end);
+                n[1] = obj_parse_f32(&cursor, end);
+                n[2] = obj_parse_f32(&cursor, end);
+            } else if (cursor[1] == 't') {
+                cursor += 2;
+                f32* uv = loader->uvs + (u64)uvs++ * 2;
+                uv[0] = obj_parse_f32(&cursor, end);
+                uv[1] = obj_parse_f32(&cursor, end);
+            }
+        } else if (cursor + 1 < end && cursor[0] == 'f' && obj_is_blank(cursor[1])) {
+            // fan around the first corner
+            obj_corner corners[3];
+            u32 corner_count = 0;
+            for (cursor = obj_skip_blanks(cursor + 1, end); !obj_token_ended(cursor, end); cursor = obj_skip_blanks(cursor, end)) {
+                obj_corner* corner = corners + MIN(corner_count, 2);
+                if (!obj_parse_corner(&cursor, end, chunk, positions, normals, uvs, corner)) {
+                    chunk->failed = true;
+                    return;
+                }
+                matched &= (loader->normal_count == 0 || corner->normal == corner->position) &&
+                           (loader->uv_count == 0 || corner->uv == corner->position);
+                if (++corner_count < 3) {
+                    continue;
+                }
+                u64 first = (u64)triangles++ * 3;
+                for (u32 k = 0; k < 3; ++k) {
+                    mesh->indices[first + k] = corners[k].position;
+                    if (loader->corner_normals) {
+                        loader->corner_normals[first + k] = corners[k].normal;
+                    }
+                    if (loader->corner_uvs) {
+                        loader->corner_uvs[first + k] = corners[k].uv;
+                    }
+                }
+                corners[1] = corners[2];
+            }
+        }
+        cursor = obj_next_line(cursor, end);
+    }
+    chunk->matched = matched;
+}
+
+void obj_unweld_job(void* params) {
+    obj_chunk* chunk = params;
+    obj_loader* loader = chunk->loader;
+    const triangle_mesh* welded = loader->mesh;
+    triangle_mesh* mesh = loader->unwelded;
+    for (u64 corner = (u64)chunk->triangles * 3; corner < (u64)chunk->triangles_end * 3; ++corner) {
+        const f32* p = welded->positions + (u64)welded->indices[corner] * 3;
+        zmemory_copy(mesh->positions + corner * 3, p, 3 * sizeof(f32));
+        mesh->indices[corner] = (u32)corner;
+        if (mesh->uvs) {
+            u32 uv = loader->corner_uvs[corner];
+            f32* out_uv = mesh->uvs + corner * 2;
+            out_uv[0] = uv != OBJ_NO_INDEX ? loader->uvs[(u64)uv * 2] : 0.0f;
+            out_uv[1] = uv != OBJ_NO_INDEX ? loader->uvs[(u64)uv * 2 + 1] : 0.0f;
+        }
+    }
+    if (mesh->normals == 0) {
+        return;
+    }
+    for (u64 triangle = chunk->triangles; triangle < chunk->triangles_end; ++triangle) {
+        for (u32 k = 0; k < 3; ++k) {
+            u64 corner = triangle * 3 + k;
+            u32 normal = loader->corner_normals[corner];
+            if (normal != OBJ_NO_INDEX) {
+                zmemory_copy(mesh->normals + corner * 3, loader->normals + (u64)normal * 3, 3 * sizeof(f32));
+                continue;
+            }
+            // the face has no normals, shade it flat
+            const f32* p0 = mesh->positions + triangle * 9;
+            vec3 edge1 = {p0[3] - p0[0], p0[4] - p0[1], p0[5] - p0[2]};
+            vec3 edge2 = {p0[6] - p0[0], p0[7] - p0[1], p0[8] - p0[2]};
+            vec3 n = vec3_cross(edge1, edge2);
+            f32* out_normal = mesh->normals + corner * 3;
+            out_normal[0] = n.x;
+            out_normal[1] = n.y;
+            out_normal[2] = n.z;
+        }
+    }
+}
+
+void obj_loader_free(obj_loader* loader) {
+    // the mesh is 0 when it ran out of memory, then nothing belongs to it
+    triangle_mesh* mesh = loader->mesh;
+    if (loader->normals && (mesh == 0 || loader->normals != mesh->normals)) {
+        zmemory_free(loader->normals, (u64)loader->normal_count * 3 * sizeof(f32));
+    }
+    if (loader->uvs && (mesh == 0 || loader->uvs != mesh->uvs)) {
+        zmemory_free(loader->uvs, (u64)loader->uv_count * 2 * sizeof(f32));
+    }
+    if (loader->corner_normals) {
+        zmemory_free(loader->corner_normals, (u64)loader->triangle_count * 3 * sizeof(u32));
+    }
+    if (loader->corner_uvs) {
+        zmemory_free(loader->corner_uvs, (u64)loader->triangle_count * 3 * sizeof(u32));
+    }
+    loader->normals = 0;
+    loader->uvs = 0;
+    loader->corner_normals = 0;
+    loader->corner_uvs = 0;
+}
+
+INLINE u32 ply_type_size(ply_type type) {
+    static const u32 sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[type];
+}
+
+INLINE f64 ply_read(const u8* data, ply_type type, bool big_endian) {
+    u32 size = ply_type_size(type);
+    u64 bits = 0;
+    for (u32 i = 0; i < size; ++i) {
+        bits |= (u64)data[big_endian ? size - 1 - i : i] << (8 * i);
+    }
+    switch (type) {
+        case PLY_TYPE_I8:
+            return (i8)bits;
+        case PLY_TYPE_U8:
+            return (u8)bits;
+        case PLY_TYPE_I16:
+            return (i16)bits;
+        case PLY_TYPE_U16:
+            return (u16)bits;
+        case PLY_TYPE_I32:
+            return (i32)bits;
+        case PLY_TYPE_U32:
+            return (u32)bits;
+        case PLY_TYPE_F32: {
+            union {
+                u32 u;
+                f32 value;
+            } f = {(u32)bits};
+            return f.value;
+        }
+        case PLY_TYPE_F64: {
+            union {
+                u64 u;
+                f64 value;
+            } f = {bits};
+            return f.value;
+        }
+        default:
+            return 0.0;
+    }
+}
+
+INLINE ply_type ply_type_from_name(const char* name) {
+    static const char* names[][2] = {
+        {"", ""}, {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+        {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"},
+    };
+    for (u32 type = PLY_TYPE_I8; type <= PLY_TYPE_F64; ++type) {
+        if (strcmp(name, names[type][0]) == 0 || strcmp(name, names[type][1]) == 0) {
+            return type;
+        }
+    }
+    return PLY_TYPE_NONE;
+}
+
+// copies the next blank separated word of the line, empty when the line has no more words
+INLINE const u8* ply_next_word(const u8* cursor, const u8* line_end, char* out_word) {
+    while (cursor < line_end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+        cursor++;
+    }
+    u32 length = 0;
+    while (cursor < line_end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r') {
+        if (length < PLY_MAX_NAME - 1) {
+            out_word[length++] = *cursor;
+        }
+        cursor++;
+    }
+    out_word[length] = 0;
+    return cursor;
+}
+
+bool ply_parse_header(const platform_file_mapping* file, ply_element* elements, u32* out_element_count, bool* out_big_endian, u64* out_body_offset) {
+    const u8* cursor = file->data;
+    const u8* end = file->data + file->size;
+    char words[4][PLY_MAX_NAME];
+    u32 element_count = 0;
+    bool has_format = false;
+    for (u32 line = 0;; ++line) {
+        const u8* line_end = cursor;
+        while (line_end < end && *line_end != '\n') {
+            line_end++;
+        }
+        if (line_end == end) {
+            LOGE("ply_parse_header: the header has no end_header");
+            return false;
+        }
+        const u8* word = cursor;
+        for (u32 w = 0; w < 4; ++w) {
+            word = ply_next_word(word, line_end, words[w]);
+        }
+        cursor = line_end + 1;
+
+        if (line == 0) {
+            if (strcmp(words[0], "ply") != 0) {
+                LOGE("ply_parse_header: not a ply file");
+                return false;
+            }
+        } else if (strcmp(words[0], "format") == 0) {
+            if (strcmp(words[1], "binary_little_endian") != 0 && strcmp(words[1], "binary_big_endian") != 0) {
+                LOGE("ply_parse_header: %s ply files are not supported, only binary ones", words[1]);
+                return false;
+            }
+            *out_big_endian = strcmp(words[1], "binary_big_endian") == 0;
+            has_format = true;
+        } else if (strcmp(words[0], "element") == 0) {
+            if (element_count == PLY_MAX_ELEMENTS) {
+                LOGE("ply_parse_header: more than %d elements", PLY_MAX_ELEMENTS);
+                return false;
+            }
+            ply_element* element = elements + element_count++;
+            zmemory_copy(element->name, words[1], PLY_MAX_NAME);
+            element->count = strtoull(words[2], 0, 10);
+        } else if (strcmp(words[0], "property") == 0) {
+            ply_element* element = element_count ? elements + element_count - 1 : 0;
+            if (element == 0 || element->property_count == PLY_MAX_PROPERTIES) {
+                LOGE("ply_parse_header: property outside of an element or too many properties");
+                return false;
+            }
+            ply_property* property = element->properties + element->property_count++;
+            if (strcmp(words[1], "list") == 0) {
+                property->count_type = ply_type_from_name(words[2]);
+                property->type = ply_type_from_name(words[3]);
+                ply_next_word(word, line_end, property->name);
+                element->list_count++;
+            } else {
+                property->type = ply_type_from_name(words[1]);
+                zmemory_copy(property->name, words[2], PLY_MAX_NAME);
+            }
+            if (property->type == PLY_TYPE_NONE || (strcmp(words[1], "list") == 0 && property->count_type == PLY_TYPE_NONE)) {
+                LOGE("ply_parse_header: unknown type in property %s", property->name);
+                return false;
+            }
+        } else if (strcmp(words[0], "end_header") == 0) {
+            break;
+        }
+    }
+    if (!has_format) {
+        LOGE("ply_parse_header: the header has no format");
+        return false;
+    }
+
+    // record layout, lists are laid out with 3 items (the size of a triangle's index list)
+    for (u32 i = 0; i < element_count; ++i) {
+        ply_element* element = elements + i;
+        u32 offset = 0;
+        for (u32 p = 0; p < element->property_count; ++p) {
+            ply_property* property = element->properties + p;
+            property->offset = offset;
+            if (property->count_type != PLY_TYPE_NONE) {
+                offset += ply_type_size(property->count_type) + 3 * ply_type_size(property->type);
+            } else {
+                offset += ply_type_size(property->type);
+            }
+        }
+        if (offset == 0) {
+            LOGE("ply_parse_header: element %s has no properties", element->name);
+            return false;
+        }
+        element->stride = offset;
+    }
+    *out_element_count = element_count;
+    *out_body_offset = cursor - file->data;
+    return true;
+}
+
+// walks records of variable size, counts (and writes when out_indices isn't 0) the triangles fanned from the indices list
+bool ply_walk(const ply_element* element, const ply_property* indices, bool big_endian, const u8** cursor, const u8* end,
+              u32* out_indices, u32 vertex_count, u64* out_triangle_count) {
+    const u8* c = *cursor;
+    u64 triangles = *out_triangle_count;
+    for (u64 record = 0; record < element->count; ++record) {
+        for (u32 p = 0; p < element->property_count; ++p) {
+            const ply_property* property = element->properties + p;
+            u32 item_size = ply_type_size(property->type);
+            if (property->count_type == PLY_TYPE_NONE) {
+                if ((u64)(end - c) < item_size) {
+                    return false;
+                }
+                c += item_size;
+                continue;
+            }
+            u32 count_size = ply_type_size(property->count_type);
+            if ((u64)(end - c) < count_size) {
+                return false;
+            }
+            f64 count = ply_read(c, property->count_type, big_endian);
+            c += count_size;
+            if (count < 0.0 || (u64)(end - c) / item_size < (u64)count) {
+                return false;
+            }
+            if (property == indices && count >= 3.0) {
+                if (out_indices) {
+                    u32 first = 0;
+                    u32 previous = 0;
+                    for (u32 k = 0; k < (u32)count; ++k) {
+                        f64 index = ply_read(c + k * item_size, property->type, big_endian);
+                        if (index < 0.0 || index >= vertex_count) {
+                            return false;
+                        }
+                        if (k == 0) {
+                            first = (u32)index;
+                        } else if (k >= 2) {
+                            u32* triangle = out_indices + (triangles + k - 2) * 3;
+                            triangle[0] = first;
+                            triangle[1] = previous;
+                            triangle[2] = (u32)index;
+                        }
+                        previous = (u32)index;
+                    }
+                }
+                triangles += (u32)count - 2;
+            }
+            c += (u64)count * item_size;
+        }
+    }
+    *cursor = c;
+    *out_triangle_count = triangles;
+    return true;
+}
+
+ply_chunk* ply_chunks_create(ply_loader* loader, u64 count, u32 stride, u32* out_chunk_count) {
+    u64 records_per_chunk = MAX(MESH_LOADER_CHUNK_SIZE / stride, 1);
+    u32 chunk_count = (u32)((count + records_per_chunk - 1) / records_per_chunk);
+    ply_chunk* chunks = zmemory_allocate(chunk_count * sizeof(ply_chunk));
+    if (chunks == 0) {
+        LOGE("ply_chunks_create: out of memory");
+        return 0;
+    }
+    for (u32 i = 0; i < chunk_count; ++i) {
+        chunks[i].loader = loader;
+        chunks[i].start = (u32)(i * records_per_chunk);
+        chunks[i].end = (u32)MIN((i + 1) * records_per_chunk, count);
+    }
+    *out_chunk_count = chunk_count;
+    return chunks;
+}
+
+void ply_check_faces_job(void* params) {
+    ply_chunk* chunk = params;
+    ply_loader* loader = chunk->loader;
+    const ply_property* indices = loader->face_indices;
+    const u8* record = loader->faces + (u64)chunk->start * loader->face_stride + indices->offset;
+    for (u32 i = chunk->start; i < chunk->end; ++i, record += loader->face_stride) {
+        if (ply_read(record, indices->count_type, loader->big_endian) != 3.0) {
+            chunk->failed = true;
+            return;
+        }
+    }
+}
+
+void ply_vertex_job(void* params) {
+    ply_chunk* chunk = params;
+    ply_loader* loader = chunk->loader;
+    triangle_mesh* mesh = loader->mesh;
+    const ply_property* const* attributes = loader->attributes;
+    const u8* record = loader->vertices + (u64)chunk->start * loader->vertex_stride;
+    for (u64 i = chunk->start; i < chunk->end; ++i, record += loader->vertex_stride) {
+        for (u32 k = 0; k < 3; ++k) {
+            mesh->positions[i * 3 + k] = ply_read(record + attributes[k]->offset, attributes[k]->type, loader->big_endian);
+        }
+        if (mesh->normals) {
+            for (u32 k = 0; k < 3; ++k) {
+                mesh->normals[i * 3 + k] = ply_read(record + attributes[3 + k]->offset, attributes[3 + k]->type, loader->big_endian);
+            }
+        }
+        if (mesh->uvs) {
+            for (u32 k = 0; k < 2; ++k) {
+                mesh->uvs[i * 2 + k] = ply_read(record + attributes[6 + k]->offset, attributes[6 + k]->type, loader->big_endian);
+            }
+        }
+    }
+}
+
+void ply_face_job(void* params) {
+    ply_chunk* chunk = params;
+    ply_loader* loader = chunk->loader;
+    const ply_property* indices = loader->face_indices;
+    u32 count_size = ply_type_size(indices->count_type);
+    u32 item_size = ply_type_size(indices->type);
+    u32 vertex_count = loader->mesh->vertex_count;
+    const u8* record = loader->faces + (u64)chunk->start * loader->face_stride + indices->offset + count_size;
+    for (u64 i = chunk->start; i < chunk->end; ++i, record += loader->face_stride) {
+        for (u32 k = 0; k < 3; ++k) {
+            f64 index = ply_read(record + k * item_size, indices->type, loader->big_endian);
+            if (index < 0.0 || index >= vertex_count) {
+                chunk->failed = true;
+                return;
+            }
+            loader->mesh->indices[i * 3 + k] = (u32)index;
+        }
+    }
+}
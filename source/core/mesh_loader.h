@@ -0,0 +1,22 @@
+#ifndef MESH_LOADER__H
+#define MESH_LOADER__H
+
+#include "triangle_mesh.h"
+#include "zthread_pool.h"
+
+/**
+ * @brief mesh_load reads a wavefront obj or a binary ply file (picked by the extension) into a triangle_mesh
+ * the file is memory mapped and cut into chunks that are parsed in parallel, a counting pass gives every chunk
+ * its offsets so the second pass writes straight into the mesh arrays, polygons are fanned into triangles
+ * obj vertices are indexed by position, when the normal or uv indices don't follow the position indices
+ * (seams) every corner gets its own vertex instead
+ * materials, groups and everything else that is not geometry are skipped
+ *
+ * @param file_path path of the .obj or .ply file
+ * @param mat material of the whole mesh
+ * @param pool the chunks are parsed on it, can be 0 to load on the calling thread
+ * @return triangle_mesh* with its bvh built, 0 if the file can't be read or is malformed
+ */
+triangle_mesh* mesh_load(const char* file_path, material* mat, zthread_pool* pool);
+
+#endif
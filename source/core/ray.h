@@ -7,16 +7,22 @@
 typedef struct ray {
     point3 origin;
     vec3 direction;
+    vec3 inv_direction; // 1 / direction, precomputed for the slab tests
+    i32 sign[3];        // 1 if the direction is negative on the axis (indexes the far/near box bounds)
 } ray;
 
+/// rays must be made with this so the slab test data matches the direction
 INLINE ray ray_create(point3 point, vec3 direction) {
+    vec3 inv_direction = {1.0 / direction.x, 1.0 / direction.y, 1.0 / direction.z};
     return (ray){
         .origin = point,
         .direction = direction,
+        .inv_direction = inv_direction,
+        .sign = {inv_direction.x < 0.0, inv_direction.y < 0.0, inv_direction.z < 0.0},
     };
 }
 
-INLINE point3 ray_at(ray* r, f32 t) {
+INLINE point3 ray_at(ray* r, f64 t) {
     return (point3){
         r->origin.x + r->direction.x * t,
         r->origin.y + r->direction.y * t,
@@ -1,18 +1,82 @@
 #include "sandbox.h"
+#include <stdlib.h>
+#include <string.h>
 
+// usage: EXE [file_name] [--seed <n>] [--passes <n>] [--checkpoint <seconds>] [--resume] [--time <seconds>] [--shard <i>/<n>]
+//        EXE merge <file_name> <n> -> combines the n shards of file_name into its image
 int main(const int argc, const char** argv) {
 
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+        if (argc != 4) {
+            LOGE("usage: EXE merge <file_name> <shard_count>");
+            return 1;
+        }
+        zmemory_init();
+        bool merged = camera_merge_shards(argv[2], atoi(argv[3]));
+        zmemory_destroy();
+        return merged ? 0 : 1;
+    }
+
     const char* file_name = "scene";
-    if (argc >= 2) {
-        file_name = argv[1];
+    const char* seed = 0;
+    camera_options options = {0};
+    for (i32 i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = argv[++i];
+        } else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            // a bad option would make camera_set_default_options drop all of them, a shard would render the whole image
+            char* end = 0;
+            options.samples_per_pass = (i32)strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || options.samples_per_pass < 0) {
+                LOGE("--passes expects a sample count >= 0, got %s", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            char* end = 0;
+            options.checkpoint_interval = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(options.checkpoint_interval >= 0.0)) {
+                LOGE("--checkpoint expects seconds >= 0, got %s", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            options.resume = true;
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            char* end = 0;
+            options.time_budget = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(options.time_budget >= 0.0)) {
+                LOGE("--time expects seconds >= 0, got %s", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            char* count = 0;
+            options.shard_index = (i32)strtol(argv[++i], &count, 10);
+            options.shard_count = *count == '/' ? (i32)strtol(count + 1, &count, 10) : 0;
+            // a bad shard would silently render the whole image on every machine
+            if (*count != '\0' || options.shard_count <= 0 || options.shard_index < 0 || options.shard_index >= options.shard_count) {
+                LOGE("--shard expects <index>/<count> with 0 <= index < count, got %s", argv[i]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            LOGE("unknown option or missing value: %s", argv[i]);
+            return 1;
+        } else {
+            file_name = argv[i];
+        }
     }
 
     zmemory_init();
 
-    random_seed();
+    if (seed) {
+        // same seed -> same image, whatever the thread count
+        random_seed_set(strtoull(seed, 0, 10));
+    } else {
+        random_seed();
+    }
+    LOGI("random seed = %llu", random_seed_get());
+    camera_set_default_options(&options);
     render_scene(file_name);
 
     zmemory_destroy();
 
     return 0;
-}
\ No newline at end of file
+}
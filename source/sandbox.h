@@ -8,8 +8,13 @@
 #include "material.h"
 #include "texture.h"
 #include "bvh.h"
+#include "bvh_wide.h"
 #include "darray.h"
 #include "box.h"
+#include "instance.h"
+#include "triangle_mesh.h"
+#include "mesh_loader.h"
+#include "platform.h"
 
 #define darray_push_back_hittable_ptr(darray, object) \
     {                                                 \
@@ -46,9 +51,9 @@ void scene_three_lambertian_spheres(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     sphere sphere_object = sphere_create((point3){0.0, 0.0, 0.0}, 0.5, 0);
-    translate left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    transform left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
+    transform right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -77,9 +82,9 @@ void scene_three_metal_spheres(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     sphere sphere_object = sphere_create((point3){0.0, 0.0, 0.0}, 0.5, 0);
-    translate left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    transform left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
+    transform right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -108,9 +113,9 @@ void scene_three_dielectric_spheres(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     sphere sphere_object = sphere_create((point3){0.0, 0.0, 0.0}, 0.5, 0);
-    translate left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    transform left = translate_object((hittable*)(&sphere_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&sphere_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
+    transform right = translate_object((hittable*)(&sphere_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -139,10 +144,10 @@ void scene_three_lambertian_quad(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     quad quad_object = quad_create((point3){-0.5, -0.5, 0.0}, (vec3){1.0, 0.0, 0.0}, (vec3){0.0, 1.0, 0.0}, 0);
-    rotate quad_object_rotated = rotate_object((hittable*)(&quad_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&quad_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&quad_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&quad_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -171,10 +176,10 @@ void scene_three_metal_quad(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     quad quad_object = quad_create((point3){-0.5, -0.5, 0.0}, (vec3){1.0, 0.0, 0.0}, (vec3){0.0, 1.0, 0.0}, 0);
-    rotate quad_object_rotated = rotate_object((hittable*)(&quad_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&quad_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&quad_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&quad_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -203,10 +208,10 @@ void scene_three_dielectric_quad(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     quad quad_object = quad_create((point3){-0.5, -0.5, 0.0}, (vec3){1.0, 0.0, 0.0}, (vec3){0.0, 1.0, 0.0}, 0);
-    rotate quad_object_rotated = rotate_object((hittable*)(&quad_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&quad_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&quad_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&quad_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&quad_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -235,10 +240,10 @@ void scene_three_lambertian_circle(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     circle circle_object = circle_create((point3){0.0, 0.0, 0.0}, 0.5, (vec3){0.0, 0.0, 1.0}, 0);
-    rotate circle_object_rotated = rotate_object((hittable*)(&circle_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&circle_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&circle_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&circle_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -267,10 +272,10 @@ void scene_three_metal_circle(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     circle circle_object = circle_create((point3){0.0, 0.0, 0.0}, 0.5, (vec3){0.0, 0.0, 1.0}, 0);
-    rotate circle_object_rotated = rotate_object((hittable*)(&circle_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&circle_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&circle_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&circle_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -299,10 +304,10 @@ void scene_three_dielectric_circle(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     circle circle_object = circle_create((point3){0.0, 0.0, 0.0}, 0.5, (vec3){0.0, 0.0, 1.0}, 0);
-    rotate circle_object_rotated = rotate_object((hittable*)(&circle_object), (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(45), 0);
-    translate left = translate_object((hittable*)(&circle_object_rotated), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&circle_object_rotated), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&circle_object_rotated), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    mat3x4 rotation = mat3x4_rotation(DEG_TO_RAD(45), (vec3){0.0, 1.0, 0.0});
+    transform left = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){-1.0, 0.5, 0.0}), rotation), (material*)(&left_mat));
+    transform center = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){0.0, 0.5, 0.0}), rotation), (material*)(&center_mat));
+    transform right = transform_create((hittable*)(&circle_object), mat3x4_mul(mat3x4_translation((vec3){1.0, 0.5, 0.0}), rotation), (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -474,7 +479,10 @@ void scene_spheres_world_using_bvh(const char* image_name) {
     mtal++;
     sph++;
 
-    hittable* bvh = bvh_create(world_array);
+    hittable* tree = bvh_create_sah(world_array);
+    LOGI("bvh sah cost = %lf", bvh_sah_cost(tree));
+    hittable* bvh = linear_bvh_create(tree);
+    bvh_destroy(tree);
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, bvh);
 
@@ -485,7 +493,7 @@ void scene_spheres_world_using_bvh(const char* image_name) {
 
     camera_destroy(cam);
     hittable_list_destroy(world);
-    bvh_destroy(bvh);
+    linear_bvh_destroy(bvh);
     zmemory_free(spheres, sizeof(sphere) * 600);
     zmemory_free(lamb_mats, sizeof(lambertian) * 200);
     zmemory_free(metals, sizeof(metal) * 200);
@@ -509,6 +517,8 @@ void scene_lights(const char* image_name) {
     hittable_list_add(world, (hittable*)(&ball));
     hittable_list_add(world, (hittable*)(&square));
     hittable_list_add(world, (hittable*)(&ball2));
+    hittable_list_add_light(world, (hittable*)(&square));
+    hittable_list_add_light(world, (hittable*)(&ball2));
 
     // render
     camera* cam = camera_create(1000, 800);
@@ -580,15 +590,27 @@ void scene(const char* image_name) {
         darray_push_back_hittable_ptr(mini_bvh_array, spheres[j]);
     }
     lambertian white = lambertian_create((color){.73, .73, .73}, 0);
-    hittable* mini_bvh = bvh_create(mini_bvh_array);
-    rotate rotate_bvh = rotate_object(mini_bvh, (vec3){0, 1, 0}, DEG_TO_RAD(15), 0);
-    translate trans = translate_object((hittable*)(&rotate_bvh), (vec3){-100, 270, 395}, (material*)(&white));
-    darray_push_back_hittable_ptr(bvh_array, trans);
+    // a uniform cloud is where the morton codes do well, and it builds in a fraction of the sah time
+    zthread_pool pool;
+    hittable* mini_bvh = 0;
+    if (zthread_pool_create(0, &pool)) {
+        mini_bvh = bvh_create_lbvh(mini_bvh_array, &pool);
+        zthread_pool_destroy(&pool);
+    } else {
+        mini_bvh = bvh_create_lbvh(mini_bvh_array, 0);
+    }
+    mat3x4 cloud_transform = mat3x4_mul(mat3x4_translation((vec3){-100, 270, 395}), mat3x4_rotation(DEG_TO_RAD(15), (vec3){0, 1, 0}));
+    transform cloud = transform_create(mini_bvh, cloud_transform, (material*)(&white));
+    darray_push_back_hittable_ptr(bvh_array, cloud);
 
-    hittable* bvh = bvh_create(bvh_array);
+    hittable* tree = bvh_create_sah(bvh_array);
+    LOGI("bvh sah cost = %lf", bvh_sah_cost(tree));
+    hittable* bvh = bvh_wide_create(tree, 0);
+    bvh_destroy(tree);
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, bvh);
+    hittable_list_add_light(world, (hittable*)(&quad_light));
 
     // render
     camera* cam = camera_create(1200, 1000);
@@ -597,7 +619,7 @@ void scene(const char* image_name) {
 
     camera_destroy(cam);
     hittable_list_destroy(world);
-    bvh_destroy(bvh);
+    bvh_wide_destroy(bvh);
     zmemory_free(spheres, sizeof(sphere) * ns);
     darray_destroy(mini_bvh_array);
     bvh_destroy(mini_bvh);
@@ -627,12 +649,12 @@ void scene_cornell(const char* image_name) {
 
     // // Box 1
     box* box1 = box_create((point3){-82.5, -165, -82.5}, (point3){82.5, 165, 82.5}, 0);
-    rotate box1_rotated = rotate_object((hittable*)box1, (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(15), 0);
-    translate box1_translated = translate_object((hittable*)(&box1_rotated), (vec3){(265 + 82.5) / 2.0, 165, -(295 + 82.5)}, (material*)(&white));
+    mat3x4 box1_transform = mat3x4_mul(mat3x4_translation((vec3){(265 + 82.5) / 2.0, 165, -(295 + 82.5)}), mat3x4_rotation(DEG_TO_RAD(15), (vec3){0, 1, 0}));
+    transform box1_instance = transform_create((hittable*)box1, box1_transform, (material*)(&white));
     // // Box 2
     box* box2 = box_create((point3){-82.5, -82.5, -82.5}, (point3){82.5, 82.5, 82.5}, 0);
-    rotate box2_rotated = rotate_object((hittable*)box2, (vec3){0.0, 1.0, 0.0}, DEG_TO_RAD(-18), 0);
-    translate box2_translated = translate_object((hittable*)(&box2_rotated), (vec3){265 + 82.5, 82.5, -(295 + 82.5) / 2.0}, (material*)(&white));
+    mat3x4 box2_transform = mat3x4_mul(mat3x4_translation((vec3){265 + 82.5, 82.5, -(295 + 82.5) / 2.0}), mat3x4_rotation(DEG_TO_RAD(-18), (vec3){0, 1, 0}));
+    transform box2_instance = transform_create((hittable*)box2, box2_transform, (material*)(&white));
 
     hittable** world_array = darray_create(hittable*);
 
@@ -642,13 +664,14 @@ void scene_cornell(const char* image_name) {
     darray_push_back_hittable_ptr(world_array, q4);
     darray_push_back_hittable_ptr(world_array, q5);
     darray_push_back_hittable_ptr(world_array, q6_light);
-    darray_push_back_hittable_ptr(world_array, box1_translated);
-    darray_push_back_hittable_ptr(world_array, box2_translated);
+    darray_push_back_hittable_ptr(world_array, box1_instance);
+    darray_push_back_hittable_ptr(world_array, box2_instance);
 
     hittable* bvh = bvh_create(world_array);
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, bvh);
+    hittable_list_add_light(world, (hittable*)(&q6_light));
 
     camera* cam = camera_create(800, 800);
     camera_render(cam, world, image_name, 45, (vec3){278, 278, 1500}, (vec3){278, 278, 0}, (vec3){0, 1, 0}, 128, 64, background_black);
@@ -661,6 +684,198 @@ void scene_cornell(const char* image_name) {
     darray_destroy(world_array);
 }
 
+void scene_instances(const char* image_name) {
+    // two bottom level objects, built once and shared by every instance
+    box* cube = box_create((point3){-0.5, -0.5, -0.5}, (point3){0.5, 0.5, 0.5}, 0);
+    int cluster_size = 16;
+    sphere* cluster_spheres = zmemory_allocate(sizeof(sphere) * cluster_size);
+    hittable** cluster_array = darray_create(hittable*);
+    for (int i = 0; i < cluster_size; i++) {
+        cluster_spheres[i] = sphere_create(vec3_random(-0.35, 0.35), 0.15, 0);
+        darray_push_back_hittable_ptr(cluster_array, cluster_spheres[i]);
+    }
+    hittable* cluster = bvh_create_sah(cluster_array);
+
+    int palette_size = 8;
+    lambertian palette[8];
+    for (int i = 0; i < palette_size; i++) {
+        palette[i] = lambertian_create(vec3_random(0.1, 0.9), 0);
+    }
+
+    // ~100k instances, each one is only a transform pair and a material
+    int side = 316;
+    int count = side * side;
+    instance* instances = zmemory_allocate(sizeof(instance) * count);
+    for (int i = 0; i < side; i++) {
+        for (int j = 0; j < side; j++) {
+            f64 scale = random_double(0.4, 1.2);
+            mat3x4 placement = mat3x4_mul(mat3x4_translation((vec3){(i - side / 2) * 1.5, scale * 0.5, (j - side / 2) * -1.5}),
+                                          mat3x4_mul(mat3x4_rotation(random_double(0, 2 * PI), (vec3){0, 1, 0}), mat3x4_scale((vec3){scale, scale, scale})));
+            hittable* object = (i + j) % 2 ? (hittable*)cube : cluster;
+            instances[i * side + j] = transform_create(object, placement, (material*)(&palette[random_int(0, palette_size - 1)]));
+        }
+    }
+    hittable* tlas = instance_tlas_create(instances, count);
+    LOGI("tlas sah cost = %lf", bvh_sah_cost(tlas));
+
+    lambertian ground_mat = lambertian_create((color){0.5, 0.5, 0.5}, 0);
+    quad ground = quad_create((point3){-300, 0, 300}, (vec3){600, 0, 0}, (vec3){0, 0, -600}, (material*)(&ground_mat));
+
+    hittable_list* world = hittable_list_create();
+    hittable_list_add(world, (hittable*)(&ground));
+    hittable_list_add(world, tlas);
+
+    camera* cam = camera_create(1200, 800);
+    camera_render(cam, world, image_name, 40, (vec3){0, 30, 60}, (vec3){0, 0, -40}, (vec3){0, 1, 0}, 64, 16, background_default);
+
+    camera_destroy(cam);
+    hittable_list_destroy(world);
+    bvh_destroy(tlas);
+    zmemory_free(instances, sizeof(instance) * count);
+    bvh_destroy(cluster);
+    darray_destroy(cluster_array);
+    zmemory_free(cluster_spheres, sizeof(sphere) * cluster_size);
+    box_destroy(cube);
+}
+
+void scene_mesh(const char* image_name) {
+    // torus tessellated into an indexed mesh, vertices are shared by the 6 triangles around them
+    int rings = 256;
+    int sides = 128;
+    f64 major_radius = 1.0;
+    f64 minor_radius = 0.35;
+    lambertian torus_mat = lambertian_create((color){0.8, 0.3, 0.1}, 0);
+    triangle_mesh* torus = triangle_mesh_allocate((rings + 1) * (sides + 1), rings * sides * 2, true, true, (material*)(&torus_mat));
+    if (torus == 0) {
+        return;
+    }
+    for (int i = 0; i <= rings; i++) {
+        f64 theta = 2 * PI * i / rings;
+        for (int j = 0; j <= sides; j++) {
+            f64 phi = 2 * PI * j / sides;
+            vec3 normal = {zcos(phi) * zcos(theta), zsin(phi), zcos(phi) * zsin(theta)};
+            u32 v = i * (sides + 1) + j;
+            torus->positions[v * 3 + 0] = major_radius * zcos(theta) + minor_radius * normal.x;
+            torus->positions[v * 3 + 1] = minor_radius * normal.y;
+            torus->positions[v * 3 + 2] = major_radius * zsin(theta) + minor_radius * normal.z;
+            torus->normals[v * 3 + 0] = normal.x;
+            torus->normals[v * 3 + 1] = normal.y;
+            torus->normals[v * 3 + 2] = normal.z;
+            torus->uvs[v * 2 + 0] = (f64)i / rings;
+            torus->uvs[v * 2 + 1] = (f64)j / sides;
+        }
+    }
+    for (int i = 0; i < rings; i++) {
+        for (int j = 0; j < sides; j++) {
+            u32 v = i * (sides + 1) + j;
+            u32* quad_indices = torus->indices + (i * sides + j) * 6;
+            quad_indices[0] = v;
+            quad_indices[1] = v + sides + 1;
+            quad_indices[2] = v + 1;
+            quad_indices[3] = v + 1;
+            quad_indices[4] = v + sides + 1;
+            quad_indices[5] = v + sides + 2;
+        }
+    }
+    if (!triangle_mesh_build(torus)) {
+        LOGE("scene_mesh: failed to build the torus");
+        triangle_mesh_destroy(torus);
+        return;
+    }
+    transform torus_instance = transform_create((hittable*)torus, mat3x4_mul(mat3x4_translation((vec3){0, 1.1, 0}), mat3x4_rotation(DEG_TO_RAD(35), (vec3){1, 0, 0})), 0);
+
+    lambertian ground_mat = lambertian_create((color){0.5, 0.5, 0.5}, 0);
+    quad ground = quad_create((point3){-10, 0, 10}, (vec3){20, 0, 0}, (vec3){0, 0, -20}, (material*)(&ground_mat));
+
+    hittable_list* world = hittable_list_create();
+    hittable_list_add(world, (hittable*)(&ground));
+    hittable_list_add(world, (hittable*)(&torus_instance));
+
+    camera* cam = camera_create(800, 600);
+    camera_render(cam, world, image_name, 45, (vec3){0, 3, 6}, (vec3){0, 0.9, 0}, (vec3){0, 1, 0}, 64, 16, background_default);
+
+    camera_destroy(cam);
+    hittable_list_destroy(world);
+    triangle_mesh_destroy(torus);
+}
+
+void scene_sphere_cloud(const char* image_name) {
+    // enough spheres that the lbvh build splits its morton codes and subtrees over the thread pool
+    zthread_pool pool;
+    if (!zthread_pool_create(0, &pool)) {
+        return;
+    }
+    lambertian orange = lambertian_create((color){0.8, 0.4, 0.1}, 0);
+    lambertian white = lambertian_create((color){0.73, 0.73, 0.73}, 0);
+    metal steel = metal_create((color){0.8, 0.8, 0.9}, 0, 0.05);
+    material* materials[3] = {(material*)(&orange), (material*)(&white), (material*)(&steel)};
+    int ns = 20000;
+    sphere* spheres = zmemory_allocate(sizeof(sphere) * ns);
+    hittable** cloud_array = darray_create(hittable*);
+    for (int j = 0; j < ns; j++) {
+        // uniform in a ball of radius 10
+        vec3 center;
+        do {
+            center = vec3_random(-1, 1);
+        } while (vec3_length_squared(center) > 1.0);
+        spheres[j] = sphere_create(vec3_mul_scalar(10, center), 0.15, materials[j % 3]);
+        darray_push_back_hittable_ptr(cloud_array, spheres[j]);
+    }
+    f64 start_time = platform_time();
+    hittable* cloud = bvh_create_lbvh(cloud_array, &pool);
+    LOGI("scene_sphere_cloud: %d spheres built in %lf sec on %u threads", ns, platform_time() - start_time, zthread_pool_thread_count(&pool));
+    zthread_pool_destroy(&pool);
+
+    hittable_list* world = hittable_list_create();
+    hittable_list_add(world, cloud);
+
+    camera* cam = camera_create(600, 400);
+    camera_render(cam, world, image_name, 40, (vec3){0, 8, 40}, (vec3){0, 0, 0}, (vec3){0, 1, 0}, 32, 16, background_default);
+
+    camera_destroy(cam);
+    hittable_list_destroy(world);
+    bvh_destroy(cloud);
+    darray_destroy(cloud_array);
+    zmemory_free(spheres, sizeof(sphere) * ns);
+}
+
+void scene_loaded_mesh(const char* image_name) {
+    zthread_pool pool;
+    if (!zthread_pool_create(0, &pool)) {
+        return;
+    }
+    metal mesh_mat = metal_create((color){0.8, 0.6, 0.2}, 0, 0.1);
+    // a small torus knot ships with the repo, any obj or binary ply works here, e.g. the stanford bunny
+    // from the stanford 3d scanning repository (the mesh is fit into a unit box below)
+    triangle_mesh* mesh = mesh_load("source/assets/knot.ply", (material*)(&mesh_mat), &pool);
+    zthread_pool_destroy(&pool);
+    if (mesh == 0) {
+        return;
+    }
+
+    // fit the mesh into a unit box standing on the ground
+    aabb box = mesh->base.box;
+    f64 size = MAX(interval_size(box.x_range), MAX(interval_size(box.y_range), interval_size(box.z_range)));
+    point3 center = aabb_centroid(&box);
+    mat3x4 placement = mat3x4_mul(mat3x4_scale((vec3){1.0 / size, 1.0 / size, 1.0 / size}),
+                                  mat3x4_translation((vec3){-center.x, -box.y_range.min, -center.z}));
+    transform mesh_instance = transform_create((hittable*)mesh, placement, 0);
+
+    lambertian ground_mat = lambertian_create((color){0.5, 0.5, 0.5}, 0);
+    quad ground = quad_create((point3){-10, 0, 10}, (vec3){20, 0, 0}, (vec3){0, 0, -20}, (material*)(&ground_mat));
+
+    hittable_list* world = hittable_list_create();
+    hittable_list_add(world, (hittable*)(&ground));
+    hittable_list_add(world, (hittable*)(&mesh_instance));
+
+    camera* cam = camera_create(800, 600);
+    camera_render(cam, world, image_name, 45, (vec3){0, 1.2, 3}, (vec3){0, 0.4, 0}, (vec3){0, 1, 0}, 64, 16, background_default);
+
+    camera_destroy(cam);
+    hittable_list_destroy(world);
+    triangle_mesh_destroy(mesh);
+}
+
 void scene_three_lambertian_cylinders(const char* image_name) {
 
     image_texture* image_tex = image_texture_create("C:/yuva/repos/raytracer/source/assets/Buddha.jpg");
@@ -673,9 +888,9 @@ void scene_three_lambertian_cylinders(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     cylinder cylinder_object = cylinder_create((point3){0.0, 0.0, 0.0}, (vec3){0.2, 0.2, 0.2}, 0.5, 0.3, 0);
-    translate left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    transform left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
+    transform right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -704,9 +919,9 @@ void scene_three_metal_cylinders(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     cylinder cylinder_object = cylinder_create((point3){0.0, 0.0, 0.0}, (vec3){0.2, 0.2, 0.2}, 0.8, 0.3, 0);
-    translate left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
-    translate right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
+    transform left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&center_mat));
+    transform right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&right_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -735,9 +950,9 @@ void scene_three_dielectric_cylinders(const char* image_name) {
 
     sphere ground = sphere_create((point3){0, -1000, 0}, 1000, (material*)(&ground_mat));
     cylinder cylinder_object = cylinder_create((point3){0.0, 0.0, 0.0}, (vec3){0.2, 0.2, 0.2}, 0.8, 0.3, 0);
-    translate left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&left_mat));
-    translate right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform left = translate_object((hittable*)(&cylinder_object), (vec3){-1.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform center = translate_object((hittable*)(&cylinder_object), (vec3){0.0, 0.5, 0.0}, (material*)(&left_mat));
+    transform right = translate_object((hittable*)(&cylinder_object), (vec3){1.0, 0.5, 0.0}, (material*)(&left_mat));
 
     hittable_list* world = hittable_list_create();
     hittable_list_add(world, (hittable*)(&ground));
@@ -767,6 +982,10 @@ void render_scene(const char* file_name) {
     // scene_lights(file_name);
     // scene_cornell(file_name);
     // scene(file_name);
+    // scene_instances(file_name);
+    // scene_mesh(file_name);
+    // scene_loaded_mesh(file_name);
+    // scene_sphere_cloud(file_name);
     // scene_three_lambertian_cylinders(file_name);
     // scene_three_metal_cylinders(file_name);
     scene_three_dielectric_cylinders(file_name);